@@ -0,0 +1,25 @@
+#pragma once
+// cta-bench用的DUT桩：只含Cta::apply_to_dut()驱动的线程块分派端口，替代Verilator生成的Vdut.h
+#include <cstdint>
+
+class Vdut {
+public:
+    uint8_t io_host_req_valid = 0;
+    uint32_t io_host_req_bits_host_wg_id;
+    uint32_t io_host_req_bits_host_kernel_size_3d_0;
+    uint32_t io_host_req_bits_host_kernel_size_3d_1;
+    uint32_t io_host_req_bits_host_kernel_size_3d_2;
+    uint32_t io_host_req_bits_host_num_wf;
+    uint32_t io_host_req_bits_host_wf_size;
+    uint32_t io_host_req_bits_host_lds_size_total;
+    uint32_t io_host_req_bits_host_sgpr_size_total;
+    uint32_t io_host_req_bits_host_vgpr_size_total;
+    uint32_t io_host_req_bits_host_sgpr_size_per_wf;
+    uint32_t io_host_req_bits_host_vgpr_size_per_wf;
+    uint32_t io_host_req_bits_host_pds_size_per_wf;
+    uint32_t io_host_req_bits_host_start_pc;
+    uint32_t io_host_req_bits_host_csr_knl;
+    uint32_t io_host_req_bits_host_gds_baseaddr;
+    uint32_t io_host_req_bits_host_pds_baseaddr;
+    uint32_t io_host_req_bits_host_gds_size_total;
+};
@@ -0,0 +1,89 @@
+// cta-bench：Kernel/Cta线程块簿记的压力测试，用DUT桩代替RTL，只模拟线程块分派/返回的握手
+//
+// 用法：cta-bench [MAX_WG [INFLIGHT]]
+//   对 NUM_WG = 2^14, 2^16, ... , MAX_WG（默认2^20）分别运行两种场景：
+//     1 kernel     一个含NUM_WG个线程块的kernel
+//     256/kernel   NUM_WG/256个各含256个线程块的kernel，开启concurrent_kernel且各在不同stream
+//   GPU上最多同时驻留INFLIGHT（默认64）个线程块，每周期分派一个线程块，驻留满或无可分派时随机返回一个
+// 输出每个线程块的平均耗时（ns）：簿记开销与线程块数成线性时该值基本不变，成平方时随NUM_WG成比例增长
+// 应以RELEASE=1构建，否则结果没有参考意义
+
+#include "Vdut.h"
+#include "cta_sche_wrapper.hpp"
+#include "kernel.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <string>
+#include <vector>
+
+static double run(std::shared_ptr<spdlog::logger> logger, uint32_t num_wg, uint32_t wg_per_kernel, uint32_t inflight) {
+    bool concurrent = wg_per_kernel < num_wg;
+    Cta cta(logger, concurrent);
+    for (uint32_t i = 0; i < num_wg / wg_per_kernel; i++) {
+        metadata_t metadata = {};
+        metadata.name = "bench";
+        metadata.stream_id = i;
+        metadata.kernel_size[0] = wg_per_kernel;
+        metadata.kernel_size[1] = 1;
+        metadata.kernel_size[2] = 1;
+        metadata.wf_size = 32;
+        metadata.wg_size = 1;
+        cta.kernel_add(std::make_shared<Kernel>(&metadata, nullptr, nullptr, logger));
+    }
+
+    Vdut dut;
+    std::vector<uint32_t> running; // 驻留在GPU上的线程块ID
+    std::mt19937 rng(10086);
+    uint64_t num_finished = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    while (!cta.is_idle()) {
+        bool valid = running.size() < inflight && cta.apply_to_dut(&dut);
+        if (valid) { // 握手成功
+            std::string kernel_name;
+            uint32_t kernel_id, wg_idx;
+            cta.wg_get_info(kernel_name, kernel_id, wg_idx);
+            running.push_back(dut.io_host_req_bits_host_wg_id);
+            cta.wg_dispatched();
+        }
+        if (!running.empty() && (!valid || running.size() >= inflight)) {
+            size_t i = rng() % running.size();
+            uint32_t wgid = running[i];
+            running[i] = running.back();
+            running.pop_back();
+            cta.wg_finish(wgid);
+            num_finished++;
+        }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    if (num_finished != num_wg) {
+        fprintf(stderr, "cta-bench: %llu of %u blocks finished\n", (unsigned long long)num_finished, num_wg);
+        exit(1);
+    }
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / num_wg;
+}
+
+int main(int argc, char** argv) {
+    uint32_t max_wg = argc > 1 ? std::stoul(argv[1], nullptr, 0) : 1u << 20;
+    uint32_t inflight = argc > 2 ? std::stoul(argv[2], nullptr, 0) : 64;
+    if (max_wg < 256 || inflight == 0) {
+        fprintf(stderr, "usage: cta-bench [MAX_WG [INFLIGHT]], MAX_WG >= 256\n");
+        return 1;
+    }
+    auto logger = spdlog::stdout_color_mt("cta-bench");
+    logger->set_level(spdlog::level::warn);
+
+    printf("%-10s %12s %12s\n", "num_wg", "1 kernel", "256/kernel");
+    printf("%-10s %12s %12s\n", "", "ns/wg", "ns/wg");
+    for (uint32_t num_wg = 1u << 14; num_wg <= max_wg; num_wg *= 4) {
+        double single = run(logger, num_wg, num_wg, inflight);
+        double multi = run(logger, num_wg, 256, inflight);
+        printf("%-10u %12.1f %12.1f\n", num_wg, single, multi);
+        if (num_wg > max_wg / 4)
+            break;
+    }
+    return 0;
+}
@@ -0,0 +1,155 @@
+// pmem-bench：PhysicalMemory页查找的微基准，对比原先的std::map页索引与现在的两级页表/mmap后端
+//
+// 用法：pmem-bench [FOOTPRINT_MIB [NUM_OPS [ACCESS_SIZE]]]
+//   在FOOTPRINT_MIB大小的区域内按两种访存序列各读、写NUM_OPS次，每次ACCESS_SIZE字节（对齐到ACCESS_SIZE）
+//   stream  顺序访问，与GPU流式访存相近，主要考察最近页缓存
+//   random  均匀随机访问，每次都需查找页表
+// 输出每次访问的平均耗时（ns）。应以RELEASE=1构建，否则结果没有参考意义
+
+#include "physical_mem.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <random>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+constexpr uint64_t PAGESIZE = 4096;
+constexpr paddr_t REGION_BASE = 0x90000000;
+
+// 原先的实现：std::map<页基址, 页>，每次访问find + at
+class MapMemory {
+public:
+    ~MapMemory() {
+        for (auto& [base, page] : m_map)
+            ::operator delete[](page, std::align_val_t(4096));
+    }
+    bool page_alloc(paddr_t base) {
+        m_map[base] = new (std::align_val_t(4096)) uint8_t[PAGESIZE];
+        return true;
+    }
+    bool page_free(paddr_t base) {
+        ::operator delete[](m_map.at(base), std::align_val_t(4096));
+        m_map.erase(base);
+        return true;
+    }
+    bool write(paddr_t paddr, const void* data_, uint64_t size) {
+        const uint8_t* data = static_cast<const uint8_t*>(data_);
+        paddr_t first_page_base = paddr & ~(PAGESIZE - 1);
+        paddr_t first_page_end = first_page_base + PAGESIZE - 1;
+        if (paddr + size - 1 > first_page_end) {
+            uint64_t size_this_copy = first_page_end - paddr + 1;
+            if (!write(first_page_end + 1, data + size_this_copy, size - size_this_copy))
+                return false;
+            size = size_this_copy;
+        }
+        if (m_map.find(first_page_base) == m_map.end())
+            return false;
+        std::memcpy(m_map.at(first_page_base) + paddr - first_page_base, data, size);
+        return true;
+    }
+    bool read(paddr_t paddr, void* data_, uint64_t size) const {
+        uint8_t* data = static_cast<uint8_t*>(data_);
+        paddr_t first_page_base = paddr & ~(PAGESIZE - 1);
+        paddr_t first_page_end = first_page_base + PAGESIZE - 1;
+        if (paddr + size - 1 > first_page_end) {
+            uint64_t size_this_copy = first_page_end - paddr + 1;
+            if (!read(first_page_end + 1, data + size_this_copy, size - size_this_copy))
+                return false;
+            size = size_this_copy;
+        }
+        auto it = m_map.find(first_page_base);
+        if (it == m_map.end())
+            return false;
+        std::memcpy(data, it->second + paddr - first_page_base, size);
+        return true;
+    }
+
+private:
+    std::map<paddr_t, uint8_t*> m_map;
+};
+
+struct result_t {
+    double read_ns;
+    double write_ns;
+};
+
+template <typename Mem> static result_t run(Mem& mem, const std::vector<paddr_t>& trace, uint64_t size) {
+    std::vector<uint8_t> buf(size, 0x5a);
+    uint64_t checksum = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (paddr_t addr : trace) {
+        mem.write(addr, buf.data(), size);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for (paddr_t addr : trace) {
+        mem.read(addr, buf.data(), size);
+        checksum += buf[0];
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    if (checksum != 0x5a * trace.size()) {
+        fprintf(stderr, "pmem-bench: read back wrong data\n");
+        exit(1);
+    }
+    return { std::chrono::duration<double, std::nano>(t2 - t1).count() / trace.size(),
+             std::chrono::duration<double, std::nano>(t1 - t0).count() / trace.size() };
+}
+
+template <typename Mem>
+static result_t bench(Mem& mem, const std::vector<paddr_t>& trace, uint64_t size, uint64_t footprint) {
+    std::vector<uint8_t> zero(PAGESIZE, 0);
+    for (paddr_t base = REGION_BASE; base < REGION_BASE + footprint; base += PAGESIZE) {
+        mem.page_alloc(base);
+        mem.write(base, zero.data(), PAGESIZE); // 预先触及所有页，缺页开销不计入结果
+    }
+    result_t r = run(mem, trace, size);
+    for (paddr_t base = REGION_BASE; base < REGION_BASE + footprint; base += PAGESIZE)
+        mem.page_free(base);
+    return r;
+}
+
+int main(int argc, char** argv) {
+    uint64_t footprint = (argc > 1 ? std::stoull(argv[1]) : 256) << 20;
+    uint64_t num_ops = argc > 2 ? std::stoull(argv[2]) : 20000000;
+    uint64_t size = argc > 3 ? std::stoull(argv[3]) : 128;
+    if (footprint == 0 || size == 0 || footprint % PAGESIZE != 0
+        || REGION_BASE + footprint > (1ull << PMEM_ADDR_BITS)) {
+        fprintf(stderr, "usage: pmem-bench [FOOTPRINT_MIB [NUM_OPS [ACCESS_SIZE]]], footprint <= %llu MiB\n",
+                (unsigned long long)(((1ull << PMEM_ADDR_BITS) - REGION_BASE) >> 20));
+        return 1;
+    }
+    auto logger = spdlog::stdout_color_mt("pmem-bench");
+    logger->set_level(spdlog::level::warn);
+
+    std::vector<std::pair<const char*, std::vector<paddr_t>>> traces(2);
+    traces[0].first = "stream";
+    traces[1].first = "random";
+    std::mt19937_64 rng(10086);
+    uint64_t num_slots = footprint / size;
+    for (uint64_t i = 0; i < num_ops; i++) {
+        traces[0].second.push_back(REGION_BASE + i % num_slots * size);
+        traces[1].second.push_back(REGION_BASE + rng() % num_slots * size);
+    }
+
+    printf("footprint %llu MiB, %llu ops of %llu bytes\n", (unsigned long long)(footprint >> 20),
+           (unsigned long long)num_ops, (unsigned long long)size);
+    printf("%-8s %-10s %12s %12s\n", "trace", "backend", "read ns/op", "write ns/op");
+    for (const auto& [name, trace] : traces) {
+        auto print = [&](const char* backend, result_t r) {
+            printf("%-8s %-10s %12.2f %12.2f\n", name, backend, r.read_ns, r.write_ns);
+        };
+        MapMemory map_mem;
+        print("std::map", bench(map_mem, trace, size, footprint));
+        PhysicalMemory pt_mem(false, PAGESIZE, logger, PhysicalMemory::BACKEND_PAGETABLE);
+        print("pagetable", bench(pt_mem, trace, size, footprint));
+        PhysicalMemory mmap_mem(false, PAGESIZE, logger, PhysicalMemory::BACKEND_MMAP);
+        print("mmap", bench(mmap_mem, trace, size, footprint));
+    }
+    return 0;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// 检查点文件的读写接口，仿真器各部件通过它保存/恢复自身状态
+// 具体实现见ventus_rtlsim_impl.cpp（基于Verilator的VerilatedSave/VerilatedRestore，与DUT模型写入同一文件）
+// 文件只在同一构建的仿真器之间通用，因此直接写入结构体的原始字节
+
+class CheckpointOut {
+public:
+    virtual ~CheckpointOut() = default;
+    virtual void write(const void* data, size_t size) = 0;
+
+    template <typename T> void pod(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        write(&value, sizeof(value));
+    }
+    void str(const std::string& s) {
+        pod<uint64_t>(s.size());
+        write(s.data(), s.size());
+    }
+    template <typename T> void vec(const std::vector<T>& v) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        pod<uint64_t>(v.size());
+        write(v.data(), v.size() * sizeof(T));
+    }
+    void vec(const std::vector<bool>& v) { // 每个bool占1字节
+        pod<uint64_t>(v.size());
+        for (bool b : v)
+            pod<uint8_t>(b);
+    }
+};
+
+class CheckpointIn {
+public:
+    virtual ~CheckpointIn() = default;
+    virtual void read(void* data, size_t size) = 0;
+
+    template <typename T> void pod(T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        read(&value, sizeof(value));
+    }
+    template <typename T> T pod() {
+        T value;
+        pod(value);
+        return value;
+    }
+    std::string str() {
+        std::string s(pod<uint64_t>(), '\0');
+        read(s.data(), s.size());
+        return s;
+    }
+    template <typename T> void vec(std::vector<T>& v) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        v.resize(pod<uint64_t>());
+        read(v.data(), v.size() * sizeof(T));
+    }
+    void vec(std::vector<bool>& v) {
+        v.resize(pod<uint64_t>());
+        for (size_t i = 0; i < v.size(); i++)
+            v[i] = pod<uint8_t>() != 0;
+    }
+};
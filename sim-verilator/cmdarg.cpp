@@ -15,6 +15,8 @@
 int cmdarg_kernel(std::string arg, std::function<void(std::shared_ptr<Kernel>)> new_kernel);
 int cmdarg_dumpmem(std::string arg, std::vector<std::pair<paddr_t, paddr_t>>* dumpmem_ranges);
 int cmdarg_error(std::vector<std::string> args);
+int cmdarg_wg_order(const char* order, std::shared_ptr<Kernel> kernel);
+int cmdarg_waveform_trigger(std::string arg, ventus_rtlsim_config_t* config);
 int cmdarg_help(int exit_id);
 
 int parse_arg(
@@ -101,6 +103,47 @@ int parse_arg(
             config->waveform.enable = true;
             config->waveform.time_begin = 0;
             config->waveform.time_end = -1;
+        } else if (args[argid] == "--waveform-rolling") {
+            if (++argid >= args.size()) {
+                cmdarg_error(std::vector<std::string>(args.begin() + argid - 1, args.end()));
+            } else {
+                config->waveform.enable = true;
+                config->waveform.time_begin = 0;
+                config->waveform.time_end = -1;
+                config->waveform.rolling = std::stoull(args[argid]);
+            }
+        } else if (args[argid] == "--waveform-trigger") {
+            if (++argid >= args.size()) {
+                cmdarg_error(std::vector<std::string>(args.begin() + argid - 1, args.end()));
+            } else if (cmdarg_waveform_trigger(args[argid], config)) {
+                cmdarg_error(std::vector<std::string>(args.begin() + argid - 1, args.begin() + argid + 1));
+            }
+        } else if (args[argid] == "--timeline") {
+            config->timeline.enable = true;
+        } else if (args[argid] == "--concurrent-kernel") {
+            config->cta.concurrent_kernel = true;
+        } else if (args[argid] == "--gvm-async") {
+            config->gvm.async = true;
+        } else if (args[argid] == "--gvm-record") {
+            if (++argid >= args.size()) {
+                cmdarg_error(std::vector<std::string>(args.begin() + argid - 1, args.end()));
+            } else {
+                config->gvm.record_file = strdup(args[argid].c_str()); // 生命周期与仿真相同，无需释放
+            }
+        } else if (args[argid] == "--gvm-sample") {
+            if (++argid >= args.size()) {
+                cmdarg_error(std::vector<std::string>(args.begin() + argid - 1, args.end()));
+            } else {
+                config->gvm.sample = strdup(args[argid].c_str());
+            }
+        } else if (args[argid] == "--gvm-report") {
+            if (++argid >= args.size()) {
+                cmdarg_error(std::vector<std::string>(args.begin() + argid - 1, args.end()));
+            } else {
+                config->gvm.report_file = strdup(args[argid].c_str());
+            }
+        } else if (args[argid] == "--gvm-mem-check") {
+            config->gvm.mem_check = true;
         } else if (args[argid] == "--snapshot") {
             if (++argid >= args.size()) {
                 cmdarg_error(std::vector<std::string>(args.begin() + argid - 1, args.end()));
@@ -109,6 +152,36 @@ int parse_arg(
                 config->snapshot.enable = (snapshot_time > 0);
                 config->snapshot.time_interval = snapshot_time;
             }
+        } else if (args[argid] == "--snapshot-rollback") {
+            if (++argid >= args.size()) {
+                cmdarg_error(std::vector<std::string>(args.begin() + argid - 1, args.end()));
+            } else {
+                config->snapshot.rollback = strdup(args[argid].c_str());
+            }
+        } else if (args[argid] == "--snapshot-bad-time") {
+            if (++argid >= args.size()) {
+                cmdarg_error(std::vector<std::string>(args.begin() + argid - 1, args.end()));
+            } else {
+                config->snapshot.bad_time = std::stoull(args[argid]);
+            }
+        } else if (args[argid] == "--snapshot-max") {
+            if (++argid >= args.size()) {
+                cmdarg_error(std::vector<std::string>(args.begin() + argid - 1, args.end()));
+            } else {
+                config->snapshot.num_max = std::stoi(args[argid]);
+            }
+        } else if (args[argid] == "--snapshot-retention") {
+            if (++argid >= args.size()) {
+                cmdarg_error(std::vector<std::string>(args.begin() + argid - 1, args.end()));
+            } else {
+                config->snapshot.retention = strdup(args[argid].c_str());
+            }
+        } else if (args[argid] == "--snapshot-mem-max") {
+            if (++argid >= args.size()) {
+                cmdarg_error(std::vector<std::string>(args.begin() + argid - 1, args.end()));
+            } else {
+                config->snapshot.mem_max = std::stoull(args[argid]) << 20;
+            }
         } else {
             cmdarg_error(std::vector<std::string>(args.begin() + argid, args.begin() + argid + 1));
         }
@@ -126,6 +199,8 @@ int cmdarg_kernel(std::string arg_raw, std::function<void(std::shared_ptr<Kernel
     char* name = nullptr;
     char* metafile = nullptr;
     char* datafile = nullptr;
+    char* stream = nullptr;
+    char* order = nullptr;
 
     char* ptr1 = NULL;
     char* subarg = strtok_r(arg, ",", &ptr1);
@@ -148,6 +223,10 @@ int cmdarg_kernel(std::string arg_raw, std::function<void(std::shared_ptr<Kernel
                 metafile = val;
             } else if (strcmp(var, "datafile") == 0) {
                 datafile = val;
+            } else if (strcmp(var, "stream") == 0) {
+                stream = val;
+            } else if (strcmp(var, "order") == 0) {
+                order = val;
             } else {
                 goto RET_ERR;
             }
@@ -174,6 +253,12 @@ int cmdarg_kernel(std::string arg_raw, std::function<void(std::shared_ptr<Kernel
                       << e.what() << std::endl;
             exit(1);
         }
+        if (stream)
+            kernel->set_stream_id(std::stoull(stream, nullptr, 0));
+        if (order && cmdarg_wg_order(order, kernel)) {
+            std::cout << "Error: --kernel order=" << order << " unrecognized" << std::endl;
+            goto RET_ERR;
+        }
         if (new_kernel)
             new_kernel(kernel);
     }
@@ -184,6 +269,76 @@ RET_ERR:
     return -1;
 }
 
+// order: row | col | morton | tiled | tiled:WxH
+int cmdarg_wg_order(const char* order, std::shared_ptr<Kernel> kernel) {
+    uint32_t tile_x = 0, tile_y = 0;
+    if (strcmp(order, "row") == 0) {
+        kernel->set_wg_order(VENTUS_WG_ORDER_ROW_MAJOR);
+    } else if (strcmp(order, "col") == 0) {
+        kernel->set_wg_order(VENTUS_WG_ORDER_COLUMN_MAJOR);
+    } else if (strcmp(order, "morton") == 0) {
+        kernel->set_wg_order(VENTUS_WG_ORDER_MORTON);
+    } else if (strcmp(order, "tiled") == 0) {
+        kernel->set_wg_order(VENTUS_WG_ORDER_TILED);
+    } else if (sscanf(order, "tiled:%ux%u", &tile_x, &tile_y) == 2 && tile_x > 0 && tile_y > 0) {
+        kernel->set_wg_order(VENTUS_WG_ORDER_TILED, tile_x, tile_y);
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// kernel=NAME,kid=N,wg=N,pc=0x...,addr=BASE:SIZE,pre=CYCLES,post=CYCLES
+// 带stop_前缀的条件（如stop_kernel=NAME、stop_addr=BASE:SIZE）为结束条件
+int cmdarg_waveform_trigger(std::string arg_raw, ventus_rtlsim_config_t* config) {
+    int len = arg_raw.size();
+    auto arg = std::make_unique<char[]>(len + 1);
+    strcpy(arg.get(), arg_raw.c_str());
+    auto& trigger = config->waveform.trigger;
+
+    char* ptr1 = NULL;
+    char* subarg = strtok_r(arg.get(), ",", &ptr1);
+    while (subarg) {
+        char* ptr2 = NULL;
+        char* var = strtok_r(subarg, "=", &ptr2);
+        char* val = strtok_r(NULL, "=", &ptr2);
+        if (!var || !val)
+            return -1;
+        ventus_waveform_match_t& match = strncmp(var, "stop_", 5) == 0 ? trigger.stop : trigger.start;
+        if (&match == &trigger.stop)
+            var += 5;
+        if (strcmp(var, "kernel") == 0) {
+            match.kernel_name = strdup(val);
+        } else if (strcmp(var, "kid") == 0) {
+            match.kernel_id = std::stoll(val, nullptr, 0);
+        } else if (strcmp(var, "wg") == 0) {
+            match.wg_idx = std::stoll(val, nullptr, 0);
+        } else if (strcmp(var, "pc") == 0) {
+            match.pc = std::stoul(val, nullptr, 0);
+        } else if (strcmp(var, "addr") == 0) {
+            char* size = strchr(val, ':');
+            if (!size)
+                return -1;
+            *size++ = '\0';
+            match.addr_base = std::stoull(val, nullptr, 0);
+            match.addr_size = std::stoull(size, nullptr, 0);
+        } else if (&match == &trigger.stop) {
+            return -1;
+        } else if (strcmp(var, "pre") == 0) {
+            trigger.pre_cycles = std::stoull(val, nullptr, 0);
+        } else if (strcmp(var, "post") == 0) {
+            trigger.post_cycles = std::stoull(val, nullptr, 0);
+        } else {
+            return -1;
+        }
+        subarg = strtok_r(NULL, ",", &ptr1);
+    }
+    config->waveform.enable = true;
+    config->waveform.time_begin = 0;
+    config->waveform.time_end = -1;
+    return 0;
+}
+
 int cmdarg_dumpmem(std::string arg_raw, std::vector<std::pair<paddr_t, paddr_t>>* dumpmem_ranges) {
     if (!dumpmem_ranges)
         return 0;
@@ -251,11 +406,29 @@ int cmdarg_help(int exit_id) {
         << "           metafile  string      // kernel的.metadata文件路径\n"
         << "           datafile  string      // kernel的.data文件路径\n"
         << "           taskid    uint        // 可选，若无则为不归属任何task的独立kernel。必须指向之前已经申明的task\n"
+        << "           stream    uint        // 可选，默认为0。配合--concurrent-kernel使用，同一stream内的kernel串行执行\n"
+        << "           order     string      // 可选，线程块分派顺序：row(默认) | col | morton | tiled | tiled:WxH\n"
         << "\n"
         << "--dump-mem BEGIN,END uint,uint   // 仿真结束后打印指定的内存地址范围[BEGIN,END]，4字节对齐\n"
         << "--waveform                       // 导出仿真波形fst文件，默认位置logs/\n"
+        << "--waveform-rolling TIME uint     // 波形只在/dev/shm中保留最近TIME~2*TIME时间，出错时才写到logs/\n"
+        << "--waveform-trigger RULES string  // 触发后才输出波形，如kernel=vecadd,wg=3,pre=1000,post=5000\n"
+        << "                                 //   stop_前缀为结束条件，如kernel=vecadd,stop_kernel=sum\n"
+        << "                                 //   条件：kernel=NAME kid=N wg=N pc=0x... addr=BASE:SIZE（pc仅GVM构建）\n"
         << "--sim-time-max NUM   uint        // number of simulation cycles\n"
         << "--snapshot INTERVAL  uint        // 每隔多少仿真时间生成一个快照，若为0则关闭快照功能\n"
+        << "--snapshot-rollback POLICY string // 出错回滚时唤醒哪个快照：oldest(默认) | nearest | bisect(需驱动设置predicate)\n"
+        << "--snapshot-bad-time TIME uint    // 配合nearest：回滚到该时刻之前最新的快照，默认自动取首条error日志的时刻\n"
+        << "--snapshot-max NUM   uint        // 最多保留多少个快照\n"
+        << "--snapshot-retention POLICY string // 快照数超限时淘汰哪个：fifo(默认，最旧) | log(近密远疏)\n"
+        << "--snapshot-mem-max MB uint       // 所有快照进程独占内存之和的上限，0表示不限\n"
+        << "--concurrent-kernel              // 允许不同stream的kernel在GPU上并发执行\n"
+        << "--timeline                       // 导出kernel与线程块执行时间线(Chrome trace JSON)，默认位置logs/\n"
+        << "--gvm-async                      // 仅GVM构建有效：在独立线程中进行GVM比对\n"
+        << "--gvm-record FILE    string      // 仅GVM构建有效：不进行比对，录制GVM轨迹供gvm-replay离线比对\n"
+        << "--gvm-sample RULES   string      // 仅GVM构建有效：只比对部分WG，如every=4,wg=3,time=0-9000\n"
+        << "--gvm-report FILE    string      // 仅GVM构建有效：首次比对出错时的JSON报告，默认位置logs/\n"
+        << "--gvm-mem-check                  // 仅GVM构建有效：kernel结束时比对DUT写入过的内存页（需REF提供）\n"
         << std::endl;
     exit(exit_id);
 }
@@ -1,13 +1,100 @@
 #include "cta_sche_wrapper.hpp"
 #include "kernel.hpp"
+#include <algorithm>
 #include <cassert>
 #include <memory>
 #include <spdlog/logger.h>
 
-Cta::Cta(std::shared_ptr<spdlog::logger> logger_)
+// 线程块ID >= 0xF0000000 保留不用
+constexpr uint32_t WGID_LIMIT = 0xF0000000;
+
+WgidAllocator::WgidAllocator(uint32_t limit)
+    : m_next(0) {
+    m_free[0] = limit;
+}
+
+bool WgidAllocator::alloc(uint32_t size, uint32_t& base) {
+    if (size == 0) {
+        base = m_next;
+        return true;
+    }
+    // 先从m_next之后寻找，找不到再从头寻找
+    auto it = m_free.upper_bound(m_next);
+    if (it != m_free.begin() && std::prev(it)->first + std::prev(it)->second > m_next) {
+        it--; // m_next位于该空闲区间内部
+    }
+    auto fit = std::find_if(it, m_free.end(), [size](const auto& range) { return range.second >= size; });
+    if (fit == m_free.end()) {
+        fit = std::find_if(m_free.begin(), it, [size](const auto& range) { return range.second >= size; });
+        if (fit == it)
+            return false;
+    }
+    // 从空闲区间中切出[start, start+size)，start不早于m_next
+    uint32_t range_base = fit->first;
+    uint32_t range_size = fit->second;
+    uint32_t start = range_base;
+    if (m_next > range_base && m_next - range_base <= range_size - size) {
+        start = m_next;
+    }
+    m_free.erase(fit);
+    if (start > range_base) {
+        m_free[range_base] = start - range_base;
+    }
+    if (range_base + range_size > start + size) {
+        m_free[start + size] = range_base + range_size - start - size;
+    }
+    base = start;
+    m_next = start + size;
+    return true;
+}
+
+void WgidAllocator::free(uint32_t base, uint32_t size) {
+    if (size == 0)
+        return;
+    auto next = m_free.lower_bound(base);
+    assert(next == m_free.end() || next->first >= base + size); // 不能与空闲区间重叠
+    // 与后一个空闲区间合并
+    if (next != m_free.end() && next->first == base + size) {
+        size += next->second;
+        next = m_free.erase(next);
+    }
+    // 与前一个空闲区间合并
+    if (next != m_free.begin()) {
+        auto prev = std::prev(next);
+        assert(prev->first + prev->second <= base);
+        if (prev->first + prev->second == base) {
+            prev->second += size;
+            return;
+        }
+    }
+    m_free[base] = size;
+}
+
+void WgidAllocator::checkpoint_save(CheckpointOut& out) const {
+    out.pod(m_next);
+    out.pod<uint64_t>(m_free.size());
+    for (const auto& [base, size] : m_free) {
+        out.pod(base);
+        out.pod(size);
+    }
+}
+
+void WgidAllocator::checkpoint_restore(CheckpointIn& in) {
+    in.pod(m_next);
+    m_free.clear();
+    for (uint64_t n = in.pod<uint64_t>(); n > 0; n--) {
+        uint32_t base = in.pod<uint32_t>();
+        m_free[base] = in.pod<uint32_t>();
+    }
+}
+
+Cta::Cta(std::shared_ptr<spdlog::logger> logger_, bool concurrent_kernel, std::function<uint64_t()> get_time)
     : m_kernel_idx_dispatching(-1)
     , m_kernel_id_next(0)
-    , m_kernel_wgid_base_next(0)
+    , m_wgid_allocator(WGID_LIMIT)
+    , m_num_kernel_finished(0)
+    , m_concurrent_kernel(concurrent_kernel)
+    , m_get_time(get_time)
     , logger(logger_) {
     assert(logger);
 };
@@ -21,6 +108,10 @@ void Cta::wg_dispatched() {
     assert(m_kernel_idx_dispatching >= 0 && m_kernel_idx_dispatching < m_kernels.size());
     std::shared_ptr<Kernel> kernel = m_kernels[m_kernel_idx_dispatching];
     assert(kernel);
+    if (m_timeline) {
+        uint64_t time = m_get_time ? m_get_time() : 0;
+        m_timeline->wg_dispatch(time, kernel->get_next_wgid(), kernel->get_kid(), kernel->get_next_wg_idx_in_kernel());
+    }
     kernel->wg_dispatched();
 }
 
@@ -41,6 +132,26 @@ bool Cta::wg_get_info(std::string& kernel_name, uint32_t& kernel_id, uint32_t& w
 
 bool Cta::is_idle() const { return m_kernels.size() == 0; }
 
+bool Cta::can_activate_next_kernel() const {
+    if (m_kernels.size() == m_kernel_idx_dispatching + 1) { // 无下一个kernel
+        return false;
+    }
+    if (m_kernel_idx_dispatching < 0) { // 之前的kernel都已结束
+        return true;
+    }
+    if (!m_concurrent_kernel) { // 需等待当前kernel完全结束
+        return m_kernels[m_kernel_idx_dispatching]->is_finished();
+    }
+    // 并发模式：同一stream中仍有未结束的kernel时需等待
+    uint64_t stream_id = m_kernels[m_kernel_idx_dispatching + 1]->get_stream_id();
+    for (int i = 0; i <= m_kernel_idx_dispatching; i++) {
+        if (m_kernels[i]->get_stream_id() == stream_id) {
+            return false;
+        }
+    }
+    return true;
+}
+
 bool Cta::apply_to_dut(Vdut* dut) {
     assert(m_kernel_idx_dispatching < 0 || m_kernel_idx_dispatching < m_kernels.size());
     std::shared_ptr<Kernel> kernel = (m_kernel_idx_dispatching == -1) ? nullptr : m_kernels[m_kernel_idx_dispatching];
@@ -48,19 +159,40 @@ bool Cta::apply_to_dut(Vdut* dut) {
 
     // 当前kernel分派结束后，切换到下一个kernel
     if (kernel == nullptr || !kernel->is_dispatching()) {
-        // TODO: 暂未实现虚拟内存，目前需要等待当前kernel完全结束才能开始分派下一个kernel
-        // if (m_kernels.size() == m_kernel_idx_dispatching + 1) { // 无下一个kernel，不分派
-        if (m_kernels.size() == m_kernel_idx_dispatching + 1 || (kernel && !kernel->is_finished())) {
+        // TODO: 暂未实现虚拟内存，默认需要等待当前kernel完全结束才能开始分派下一个kernel
+        //       开启concurrent_kernel后，只需等待同一stream中的前序kernel结束
+        if (!can_activate_next_kernel()) {
             // 需等待当前kernel或者无下一个kernel，不分派WG
             dut->io_host_req_valid = false;
             return false;
         } else {
             // 激活下一个kernel，准备分派其线程块
-            kernel = m_kernels[++m_kernel_idx_dispatching];
-            assert(kernel && !kernel->is_activated() && !kernel->is_finished());
-            assert(m_kernel_wgid_base_next <= 0xEFFFFFFF); // 当前实现中线程块ID不会回收，需防止其溢出
-            kernel->activate(m_kernel_id_next++, m_kernel_wgid_base_next);
-            m_kernel_wgid_base_next += kernel->get_num_wg();
+            std::shared_ptr<Kernel> kernel_next = m_kernels[m_kernel_idx_dispatching + 1];
+            assert(kernel_next && !kernel_next->is_activated() && !kernel_next->is_finished());
+            uint32_t wgid_base;
+            if (!m_wgid_allocator.alloc(kernel_next->get_num_wg(), wgid_base)) {
+                // 线程块ID暂时不足，等待其它kernel结束后回收
+                if (m_wgid_index.empty()) {
+                    logger->critical(
+                        "kernel {} has {} blocks, too many to allocate block id", kernel_next->get_kname(),
+                        kernel_next->get_num_wg()
+                    );
+                    assert(0);
+                }
+                dut->io_host_req_valid = false;
+                return false;
+            }
+            kernel = kernel_next;
+            m_kernel_idx_dispatching++;
+            kernel->activate(m_kernel_id_next++, wgid_base, m_get_time ? m_get_time() : 0);
+            if (m_timeline) {
+                m_timeline->kernel_activate(
+                    kernel->get_time_activated(), kernel->get_kid(), kernel->get_kname(), kernel->get_num_wg()
+                );
+            }
+            if (kernel->get_num_wg() != 0) {
+                m_wgid_index[wgid_base] = kernel;
+            }
         }
     }
 
@@ -96,24 +228,80 @@ bool Cta::apply_to_dut(Vdut* dut) {
 }
 
 void Cta::wg_finish(uint32_t wgid) {
-    for (auto it = m_kernels.begin(); it != m_kernels.end(); it++) {
-        std::shared_ptr<Kernel> kernel = *it;
-        uint32_t wg_idx = -1;
-        if (kernel->is_running() && kernel->is_wg_belonging(wgid, &wg_idx)) { // 寻找wg所属kernel
-            assert(it <= m_kernels.begin() + m_kernel_idx_dispatching);
-            kernel->wg_finish(wgid);
-            logger->debug(
-                "block{0:<2} finished (kernel{1:<2} {2} block{3:<2})", wgid, kernel->get_kid(), kernel->get_kname(),
-                wg_idx
+    // 寻找wg所属kernel：起始线程块ID不大于wgid的最后一个kernel
+    auto it_index = m_wgid_index.upper_bound(wgid);
+    assert(it_index != m_wgid_index.begin()); // 总应当可以找到WG所属的Kernel
+    it_index--;
+    std::shared_ptr<Kernel> kernel = it_index->second;
+    uint32_t wg_idx = -1;
+    bool belonging = kernel->is_running() && kernel->is_wg_belonging(wgid, &wg_idx);
+    assert(belonging);
+
+    kernel->wg_finish(wgid);
+    if (m_timeline) {
+        m_timeline->wg_return(m_get_time ? m_get_time() : 0, wgid);
+    }
+    logger->debug(
+        "block{0:<2} finished (kernel{1:<2} {2} block{3:<2})", wgid, kernel->get_kid(), kernel->get_kname(), wg_idx
+    );
+    if (kernel->is_finished()) { // 整个kernel已经结束，删除之
+        if (m_get_time) {
+            logger->info(
+                "kernel{0:<2} {1} finished, {2} blocks in {3} time-unit ({4} order)", kernel->get_kid(),
+                kernel->get_kname(), kernel->get_num_wg(), m_get_time() - kernel->get_time_activated(),
+                kernel->get_wg_order_name()
             );
-            if (kernel->is_finished()) { // 整个kernel已经结束，删除之
-                logger->info("kernel{0:<2} {1} finished", kernel->get_kid(), kernel->get_kname());
-                kernel->deactivate();
-                m_kernels.erase(it);
-                m_kernel_idx_dispatching--; // 可能会减至-1
-            }
-            return;
+        } else {
+            logger->info("kernel{0:<2} {1} finished", kernel->get_kid(), kernel->get_kname());
+        }
+        if (m_timeline) {
+            m_timeline->kernel_finish(m_get_time ? m_get_time() : 0, kernel->get_kid());
+        }
+        kernel->deactivate();
+        m_wgid_index.erase(it_index);
+        m_wgid_allocator.free(kernel->get_wgid_base(), kernel->get_num_wg());
+        // 已激活的kernel总在m_kernels的前端
+        auto it = std::find(m_kernels.begin(), m_kernels.begin() + m_kernel_idx_dispatching + 1, kernel);
+        assert(it != m_kernels.begin() + m_kernel_idx_dispatching + 1);
+        m_kernels.erase(it);
+        m_kernel_idx_dispatching--; // 可能会减至-1
+        m_num_kernel_finished++;
+    }
+}
+
+bool Cta::checkpoint_save(CheckpointOut& out) const {
+    for (int i = m_kernel_idx_dispatching + 1; i < m_kernels.size(); i++) {
+        if (m_kernels[i]->has_data_load_callback()) {
+            logger->error(
+                "kernel {} is waiting to load its data, cannot be saved to checkpoint", m_kernels[i]->get_kname()
+            );
+            return false;
+        }
+    }
+    out.pod<uint64_t>(m_kernels.size());
+    for (const auto& kernel : m_kernels) {
+        kernel->checkpoint_save(out);
+    }
+    out.pod(m_kernel_idx_dispatching);
+    out.pod(m_kernel_id_next);
+    out.pod(m_num_kernel_finished);
+    m_wgid_allocator.checkpoint_save(out);
+    return true;
+}
+
+void Cta::checkpoint_restore(CheckpointIn& in, std::function<void(const metadata_t*)> finish_callback) {
+    assert(m_kernels.empty() && m_wgid_index.empty());
+    for (uint64_t n = in.pod<uint64_t>(); n > 0; n--) {
+        m_kernels.push_back(Kernel::checkpoint_restore(in, nullptr, finish_callback, logger));
+    }
+    in.pod(m_kernel_idx_dispatching);
+    in.pod(m_kernel_id_next);
+    in.pod(m_num_kernel_finished);
+    m_wgid_allocator.checkpoint_restore(in);
+    // 线程块ID区间索引由已激活的kernel重建
+    for (int i = 0; i <= m_kernel_idx_dispatching; i++) {
+        if (m_kernels[i]->get_num_wg() != 0) {
+            m_wgid_index[m_kernels[i]->get_wgid_base()] = m_kernels[i];
         }
     }
-    assert(0); // 总应当可以找到WG所属的Kernel
 }
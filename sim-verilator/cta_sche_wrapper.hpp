@@ -1,13 +1,38 @@
 #pragma once
 #include "Vdut.h"
+#include "checkpoint.hpp"
 #include "kernel.hpp"
+#include "timeline.hpp"
+#include <functional>
+#include <map>
 #include <memory>
 #include <spdlog/logger.h>
 #include <vector>
 
+// 线程块ID分配器：为每个kernel分配连续的线程块ID区间，kernel结束后回收
+// 空闲区间按next-fit方式分配，刚回收的ID不会被立即重用，便于在日志中区分先后kernel
+class WgidAllocator {
+public:
+    WgidAllocator(uint32_t limit); // 可分配的ID范围为[0, limit)
+
+    bool alloc(uint32_t size, uint32_t& base); // 无足够大的空闲区间时return false
+    void free(uint32_t base, uint32_t size);
+
+    void checkpoint_save(CheckpointOut& out) const;
+    void checkpoint_restore(CheckpointIn& in);
+
+private:
+    std::map<uint32_t, uint32_t> m_free; // 空闲区间 base -> size，区间互不相邻
+    uint32_t m_next;                     // next-fit搜索起点
+};
+
 class Cta {
 public:
-    Cta(std::shared_ptr<spdlog::logger> logger);
+    // get_time: 获取当前仿真时间，用于统计kernel执行时长
+    Cta(
+        std::shared_ptr<spdlog::logger> logger, bool concurrent_kernel = false,
+        std::function<uint64_t()> get_time = nullptr
+    );
 
     bool apply_to_dut(Vdut* dut); // DUT WG new IO port stimuli
     void wg_dispatched();
@@ -22,12 +47,28 @@ public:
     void wg_finish(uint32_t wgid);
 
     bool is_idle() const;
+    uint64_t get_num_kernel_finished() const { return m_num_kernel_finished; } // 已结束的kernel总数
+    uint32_t get_num_kernel_active() const { return m_kernel_idx_dispatching + 1; } // 已激活且未结束的kernel数
+    void set_timeline(Timeline* timeline) { m_timeline = timeline; }          // 记录kernel与线程块事件，nullptr则不记录
+
+    // 检查点：保存/恢复kernel队列（含线程块状态）与线程块ID分配情况
+    // 有尚未激活且需延迟加载数据的kernel时无法保存（加载数据的回调无法保存），return false
+    bool checkpoint_save(CheckpointOut& out) const;
+    // 只能对新建的Cta调用，恢复出的kernel统一使用给定的结束回调
+    void checkpoint_restore(CheckpointIn& in, std::function<void(const metadata_t*)> finish_callback);
 
 private:
-    std::vector<std::shared_ptr<Kernel>> m_kernels;
+    bool can_activate_next_kernel() const;
+
+    std::vector<std::shared_ptr<Kernel>> m_kernels; // [0, m_kernel_idx_dispatching]为已激活且未结束的kernel
     int m_kernel_idx_dispatching;
     uint32_t m_kernel_id_next;
-    uint32_t m_kernel_wgid_base_next;
+    WgidAllocator m_wgid_allocator;
+    std::map<uint32_t, std::shared_ptr<Kernel>> m_wgid_index; // 已激活kernel的线程块ID区间索引: wgid_base -> kernel
+    uint64_t m_num_kernel_finished;
+    const bool m_concurrent_kernel;
+    std::function<uint64_t()> m_get_time;
+    Timeline* m_timeline = nullptr;
 
     std::shared_ptr<spdlog::logger> logger;
 };
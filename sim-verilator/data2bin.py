@@ -0,0 +1,104 @@
+"""
+将POCL导出的 .metadata + .data（文本十六进制）转换为二进制kernel数据文件，供sim-VentusRTL直接mmap加载
+
+用法: python3 data2bin.py xxx.metadata xxx.data [-o xxx.data.bin]
+之后在ventus_args.txt中将 datafile=xxx.data 替换为 datafile=xxx.data.bin 即可，metafile不变
+
+二进制格式（小端序），与sim_main.cpp中kernel_load_data_binary()保持一致:
+    header:       char magic[8] = "VTKDATA\\0", uint32 version = 1, uint32 num_buffer
+    buffer table: num_buffer x { uint64 base, uint64 size, uint64 offset }  # offset为数据在文件中的位置
+    buffer data:  各buffer的原始字节，起始位置按BUFFER_ALIGN对齐
+"""
+import argparse
+import string
+import struct
+import sys
+
+MAGIC = b"VTKDATA\0"
+VERSION = 1
+BUFFER_ALIGN = 64
+
+# 与kernel.cpp中Kernel::readHexFile()逻辑相同
+def read_hex_file(filename, item_bits=64):
+    items = []
+    bits = 0
+    value = 0
+    leftside = False
+    with open(filename, "r") as f:
+        content = f.read()
+    for c in content:
+        if c == "\n":
+            if bits != 0:
+                leftside = True
+            continue
+        if c not in string.hexdigits:
+            print(f"Invalid character found: {c!r} in {filename}", file=sys.stderr)
+            continue
+        hex_value = int(c, 16)
+        if leftside:
+            value |= hex_value << (92 - bits)
+        else:
+            value = ((value << 4) | hex_value) & 0xFFFFFFFFFFFFFFFF
+        bits += 4
+        if bits >= item_bits:
+            items.append(value)
+            value = 0
+            bits = 0
+            leftside = False
+    if bits > 0:
+        print("Warning: Incomplete item found at the end of the file!", file=sys.stderr)
+    return items
+
+# 与kernel.cpp中Kernel::assignMetadata()的字段顺序相同，只取出buffer相关信息
+def read_buffers(metadata_file):
+    items = read_hex_file(metadata_file)
+    num_buffer = items[13]
+    base = items[14 : 14 + num_buffer]
+    size = items[14 + num_buffer : 14 + 2 * num_buffer]
+    return list(zip(base, size))
+
+# 与sim_main.cpp中kernel_load_data_text()逻辑相同：每行一个32bit字，行内为大端十六进制
+def read_data(data_file, buffers):
+    with open(data_file, "r") as f:
+        lines = iter(f.read().split("\n"))
+    result = []
+    for base, size in buffers:
+        assert size % 4 == 0, f"buffer at 0x{base:x} size {size} is not a multiple of 4"
+        data = bytearray()
+        readbytes = 0
+        while readbytes < size:
+            line = next(lines, "").strip()
+            for i in range(len(line), 0, -2):
+                data.append(int(line[i - 2 : i], 16))
+            readbytes += 4
+        result.append((base, bytes(data)))
+    return result
+
+def write_bin(output, buffers):
+    header_size = 16 + 24 * len(buffers)
+    offset = header_size
+    table = b""
+    payload = b""
+    for base, data in buffers:
+        padding = (-offset) % BUFFER_ALIGN
+        payload += b"\0" * padding
+        offset += padding
+        table += struct.pack("<QQQ", base, len(data), offset)
+        payload += data
+        offset += len(data)
+    with open(output, "wb") as f:
+        f.write(MAGIC + struct.pack("<II", VERSION, len(buffers)))
+        f.write(table)
+        f.write(payload)
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="convert .metadata + .data to binary kernel data file")
+    parser.add_argument("metadata")
+    parser.add_argument("data")
+    parser.add_argument("-o", "--output", help="output file, default: <data>.bin")
+    args = parser.parse_args()
+
+    buffers = read_data(args.data, read_buffers(args.metadata))
+    output = args.output if args.output else args.data + ".bin"
+    write_bin(output, buffers)
+    print(f"{len(buffers)} buffers written to {output}")
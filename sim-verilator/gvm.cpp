@@ -8,47 +8,19 @@
 
 #include "gvmref_interface.h"
 #include "gvm_global_var.hpp"
+#include "gvm_dpic.hpp"
 #include "gvm.hpp"
 #include "gvm_structs.hpp"
 #include <bitset>
 #include <array>
 #include "gvm_macro.h"
+#include <algorithm>
+#include <cstring>
+#include <fmt/os.h>
+#include <stdexcept>
 #include <string>
 
-//
-// ------------------------- insn related ----------------------------------------
-//
-
-bool gvm_t::isInsnCare(uint32_t insn, const std::vector<care_insn_t> care_insns) {
-  // 判断指令是否 care
-  for (const auto& pattern : care_insns) {
-    if ((insn & pattern.mask) == pattern.value) {
-      return true;
-    }
-  }
-  return false;
-}
-
-void gvm_t::disasm(uint32_t insn, char* insn_name) {
-  std::vector<std::string> matched_names;
-  for (const auto& pattern : disasm_table) {
-    if ((insn & pattern.mask) == pattern.value) {
-      matched_names.push_back(pattern.name);
-    }
-  }
-  if (matched_names.empty()) {
-    strcpy(insn_name, " ");
-    return;
-  }
-  if (matched_names.size() > 1) {
-    logger->error("GVM error: multiple disasm matches for insn 0x{:08x}: {}"
-      , insn, fmt::join(matched_names, " "));
-    assert(0);
-  } else {
-    strcpy(insn_name, matched_names[0].c_str());
-  }
-  return;
-}
+constexpr uint32_t INSN_ENDPRG = 0x0000400B; // endprg 指令的编码
 
 //
 // ------------------------- gvm_t::getDut() ----------------------------------------------
@@ -72,17 +44,125 @@ static std::string mask_to_string(const std::array<bool, 32>& mask, size_t n) {
 }
 
 void gvm_t::getDut() {
+  if (!xreg_from_events) {
+    gvm_dut_xreg_invalidate(); // 标量寄存器堆仅在需要时读取
+  }
+  getDutDropUnsampled(); // 丢弃未采样 WG 的事件，之后的处理与不采样时相同
   getDutWarpNew(); // 添加新 warp 条目
   getDutWarpFinish(); // 删除已完成 warp 条目
   getDutInsnDispatch(); // 添加新指令条目，其中不关心的指令直接置为 single_insn_cmp.cmp_pass = 1
   getDutInsnFinish(); // 标记指令条目为已完成，维护 dut_done 与 dut_result
-  getDutXReg(); // 根据 warp 条目更新 XReg 条目
   getDutWarpNewSetRefXReg();
-  clearGlobal(); // 清空全局变量
+  dut_events.clear(); // 清空本周期事件
+}
+
+uint32_t& gvm_t::unsampledWgByHw(uint32_t sm_id, uint32_t hardware_warp_id) {
+  if (sm_id >= unsampled_wg_by_hw.size()) {
+    unsampled_wg_by_hw.resize(sm_id + 1);
+  }
+  if (hardware_warp_id >= unsampled_wg_by_hw[sm_id].size()) {
+    unsampled_wg_by_hw[sm_id].resize(hardware_warp_id + 1, NOT_UNSAMPLED);
+  }
+  return unsampled_wg_by_hw[sm_id][hardware_warp_id];
+}
+
+void gvm_t::getDutDropUnsampled() {
+  if (sample.all() && unsampled_wgs.empty()) {
+    return;
+  }
+  // 新分派的 warp：同一 WG 的 warp 须得到相同的采样结果，已有 warp 在跟踪或已判定未采样的 WG 沿用之前的结果
+  std::erase_if(dut_events.cta2warp, [this](const Cta2WarpData& item) {
+    auto wg_it = unsampled_wgs.find(item.software_wg_id);
+    if (wg_it == unsampled_wgs.end()) {
+      auto warp_it = dut_active_warps.lower_bound({ item.software_wg_id, 0 });
+      bool wg_active = warp_it != dut_active_warps.end() && warp_it->first.first == item.software_wg_id;
+      if (wg_active || sample.wgSampled(item.software_wg_id, dut_events.time)) {
+        return false;
+      }
+      wg_it = unsampled_wgs.emplace(item.software_wg_id, unsampled_wg_t{}).first;
+      logger->debug("GVM sample: software_wg_id {} is not sampled", item.software_wg_id);
+    }
+    wg_it->second.warps.push_back(item.software_warp_id);
+    wg_it->second.num_running++;
+    unsampledWgByHw(item.sm_id, item.hardware_warp_id) = item.software_wg_id;
+    // 与被采样的 warp 一样同步初始寄存器，否则 REF 以全零寄存器运行，之后的 kernel 读到的 REF 内存可能不对
+    dut_active_warp_t warp;
+    warp.sm_id = item.sm_id;
+    warp.hardware_warp_id = item.hardware_warp_id;
+    warp.software_wg_id = item.software_wg_id;
+    warp.software_warp_id = item.software_warp_id;
+    warp.xreg_base = item.sgpr_base;
+    warp.xreg_usage = g_sgprUsage;
+    setRefXReg(warp);
+    return true;
+  });
+  if (unsampled_wgs.empty()) {
+    return;
+  }
+
+  auto unsampled = [this](const auto& item) {
+    return item.sm_id < unsampled_wg_by_hw.size() && item.hardware_warp_id < unsampled_wg_by_hw[item.sm_id].size()
+      && unsampled_wg_by_hw[item.sm_id][item.hardware_warp_id] != NOT_UNSAMPLED;
+  };
+  std::erase_if(dut_events.xreg_wb, unsampled);
+  std::erase_if(dut_events.vreg_wb, unsampled);
+  std::vector<std::pair<uint32_t, uint32_t>> finished; // (sm_id, hardware_warp_id)
+  std::erase_if(dut_events.insn_dispatch, [&](const InsnDispatchData& item) {
+    if (!unsampled(item)) {
+      return false;
+    }
+    if (item.insn == INSN_ENDPRG) {
+      finished.emplace_back(item.sm_id, item.hardware_warp_id);
+    }
+    return true;
+  });
+  // endprg 之后该硬件 warp 的剩余事件与被采样的 warp 一样按“找不到 warp”处理
+  for (const auto& [sm_id, hardware_warp_id] : finished) {
+    uint32_t& wg = unsampledWgByHw(sm_id, hardware_warp_id);
+    auto wg_it = unsampled_wgs.find(wg);
+    assert(wg_it != unsampled_wgs.end() && wg_it->second.num_running > 0);
+    wg = NOT_UNSAMPLED;
+    if (--wg_it->second.num_running == 0) {
+      advanceRefWg(wg_it->first, wg_it->second.warps);
+      unsampled_wgs.erase(wg_it);
+    }
+  }
+}
+
+void gvm_t::advanceRefWg(uint32_t software_wg_id, const std::vector<uint32_t>& software_warp_ids) {
+  // 不比对也不记录指令，只为让 REF 内存中包含该 WG 的结果，供之后的 kernel 读取
+  // 轮流步进各 warp，直到 PC 不再前进（停在 barrier 或已结束）后换下一个，一整轮都没有进展时结束
+  // kernel 中的死循环会让 REF 永远有进展，超过 UNSAMPLED_WG_MAX_STEPS 步时放弃
+  gvmref_step_return_info_t info;
+  uint64_t num_steps = 0;
+  for (bool progress = true; progress;) {
+    progress = false;
+    for (uint32_t warp_id : software_warp_ids) {
+      while (true) {
+        if (num_steps >= UNSAMPLED_WG_MAX_STEPS) {
+          logger->error("GVM error: REF of unsampled software_wg_id {} did not finish in {} steps, "
+            "REF memory may lack its results", software_wg_id, num_steps);
+          return;
+        }
+        const uint32_t pc = gvmref_get_next_pc(software_wg_id, warp_id);
+        gvmref_step(software_wg_id, warp_id, &info);
+        num_steps++;
+        if (info.wg_done) {
+          logger->debug("GVM sample: REF of unsampled software_wg_id {} advanced {} steps", software_wg_id, num_steps);
+          return;
+        }
+        if (gvmref_get_next_pc(software_wg_id, warp_id) == pc) {
+          break;
+        }
+        progress = true;
+      }
+    }
+  }
+  logger->debug("GVM sample: REF of unsampled software_wg_id {} advanced {} steps", software_wg_id, num_steps);
 }
 
 void gvm_t::getDutWarpNew() {
-  for (const auto& item : g_cta2warp_data) {
+  for (const auto& item : dut_events.cta2warp) {
     dut_active_warp_t d;
     d.sm_id = item.sm_id;
     d.hardware_warp_id = item.hardware_warp_id;
@@ -92,20 +172,20 @@ void gvm_t::getDutWarpNew() {
     d.xreg_usage = g_sgprUsage; // 临时特殊处理
     // d.vreg_base = item.vgpr_base;
     d.base_dispatch_id_set = 0;
+    d.insns_base = 0;
+    d.retire_scan_dispatch_id = 0;
+    d.retire_ready_dispatch_id = 0;
+    d.num_done_beyond_scan = 0;
+    d.retire_scan_barriered = false;
     d.wg_slot_id_in_warp_sche = item.wg_slot_id_in_warp_sche;
     d.num_thread = item.num_thread_in_warp;
+    d.checked = sample.warpChecked(d.software_wg_id, d.software_warp_id);
+    d.history.resize(history_depth);
+    d.history_count = 0;
 
     // check if the warp is already in the list
-    bool found_sw = false;
-    bool found_hw = false;
-    for (const auto& warp : dut_active_warps) {
-      if (warp.second.software_wg_id == d.software_wg_id && warp.second.software_warp_id == d.software_warp_id) {
-        found_sw = true;
-      }
-      if (warp.second.sm_id == d.sm_id && warp.second.hardware_warp_id == d.hardware_warp_id) {
-        found_hw = true;
-      }
-    }
+    bool found_sw = dut_active_warps.find({ d.software_wg_id, d.software_warp_id }) != dut_active_warps.end();
+    bool found_hw = findDutWarpByHw(d.sm_id, d.hardware_warp_id) != nullptr;
     if (found_sw) {
       logger->error("GVM error: repeated cta2warp dispatch with same software_wg_id {} & software_warp_id {}.\n",
         d.software_wg_id, d.software_warp_id);
@@ -116,51 +196,91 @@ void gvm_t::getDutWarpNew() {
         d.sm_id, d.hardware_warp_id);
       assert(0);
     }
-    dut_active_warps[{d.software_wg_id, d.software_warp_id}] = d;
+    auto& warp = dut_active_warps[{d.software_wg_id, d.software_warp_id}];
+    warp = std::move(d);
+    setDutWarpByHw(warp.sm_id, warp.hardware_warp_id, &warp);
+  }
+}
+
+dut_active_warp_t* gvm_t::findDutWarpByHw(uint32_t sm_id, uint32_t hardware_warp_id) {
+  if (sm_id >= dut_warps_by_hw.size() || hardware_warp_id >= dut_warps_by_hw[sm_id].size()) {
+    return nullptr;
+  }
+  return dut_warps_by_hw[sm_id][hardware_warp_id];
+}
+
+void gvm_t::setDutWarpByHw(uint32_t sm_id, uint32_t hardware_warp_id, dut_active_warp_t* warp) {
+  if (sm_id >= dut_warps_by_hw.size()) {
+    dut_warps_by_hw.resize(sm_id + 1);
+  }
+  if (hardware_warp_id >= dut_warps_by_hw[sm_id].size()) {
+    dut_warps_by_hw[sm_id].resize(hardware_warp_id + 1, nullptr);
   }
+  dut_warps_by_hw[sm_id][hardware_warp_id] = warp;
 }
 
 void gvm_t::getDutWarpFinish() {
-  for (const auto& item : g_insn_dispatch_data) {
-    if (item.insn == 0x0000400B) {
-      // 0x0000400B 是 endprg 指令
+  for (const auto& item : dut_events.insn_dispatch) {
+    if (item.insn == INSN_ENDPRG) {
       // delete dut_active_warp
-      bool found_dut_active_warp = false;
-      for (auto warp_it = dut_active_warps.begin(); warp_it != dut_active_warps.end();) {
-        if (warp_it->second.sm_id == item.sm_id && warp_it->second.hardware_warp_id == item.hardware_warp_id) {
-          if (found_dut_active_warp) {
-            printf("GVM error in `gvm_t::getDutWarpFinish`: "
-              "multiple items in `dut_active_warps` with same sm_id and hardware_warp_id\n");
-            assert(0);
-          }
-          logger->debug(fmt::format("GVM info: endprg dispatched, deleting warp with sm_id: {}, hardware_warp_id: {}\n",
-            warp_it->second.sm_id, warp_it->second.hardware_warp_id));
-          warp_it = dut_active_warps.erase(warp_it);
-          found_dut_active_warp = true;
-        } else {
-          ++warp_it;
-        }
-      }
-      if (!found_dut_active_warp) {
+      dut_active_warp_t* warp = findDutWarpByHw(item.sm_id, item.hardware_warp_id);
+      if (warp == nullptr) {
         printf("GVM error in `gvm_t::getDutWarpFinish`: "
           "no item in `dut_active_warps` with required sm_id and hardware_warp_id\n");
         assert(0);
+        continue;
       }
-      // 这里最好把对应的 ref warp 跑到头
+      logger->debug(fmt::format("GVM info: endprg dispatched, deleting warp with sm_id: {}, hardware_warp_id: {}\n",
+        warp->sm_id, warp->hardware_warp_id));
+      finishRefWarp(*warp);
+      setDutWarpByHw(item.sm_id, item.hardware_warp_id, nullptr);
+      dut_active_warps.erase({ warp->software_wg_id, warp->software_warp_id });
     }
   }
 }
 
+void gvm_t::finishRefWarp(dut_active_warp_t& warp) {
+  // endprg 之前的指令 DUT 均已分派，但末尾没有被之后关心的指令带动 retire 的部分（例如最后的 store）REF 尚未执行
+  // 这里不再比对，只步进 REF，使 REF 内存包含该 warp 的全部写入
+  gvmref_step_return_info_t info;
+  uint32_t num_steps = 0;
+  for (const insn_t* insn; (insn = warp.findInsn(warp.next_retire_dispatch_id)) != nullptr;
+    warp.next_retire_dispatch_id++) {
+    if (insn->extended) {
+      gvmref_step(warp.software_wg_id, warp.software_warp_id, &info); // 跳过 regext
+    }
+    const uint32_t pc = gvmref_get_next_pc(warp.software_wg_id, warp.software_warp_id);
+    if (pc != insn->pc) {
+      logger->error("GVM error: DUT and REF next PC mismatch at endprg on software_wg_id: {}, software_warp_id: {}. "
+        "DUT next PC: 0x{:08x}, REF next PC: 0x{:08x}", warp.software_wg_id, warp.software_warp_id, insn->pc, pc);
+      break;
+    }
+    gvmref_step(warp.software_wg_id, warp.software_warp_id, &info);
+    num_steps++;
+    if (gvmref_get_next_pc(warp.software_wg_id, warp.software_warp_id) == pc) {
+      // REF 停在 barrier 上（同一 WG 还有 warp 未到达）。该 warp 随即被移除，之后没有人再步进它，
+      // 其余未 retire 的指令在 REF 中不会执行，REF 内存可能缺少它们的写入
+      logger->debug("GVM info: REF of software_wg_id {}, software_warp_id {} blocked at barrier 0x{:08x} at endprg, "
+        "its remaining unretired insns are dropped", warp.software_wg_id, warp.software_warp_id, pc);
+      break;
+    }
+  }
+  if (num_steps > 0) {
+    logger->debug("GVM info: REF of software_wg_id {}, software_warp_id {} stepped {} unretired insns at endprg",
+      warp.software_wg_id, warp.software_warp_id, num_steps);
+  }
+}
+
 void gvm_t::getDutInsnDispatch() {
-  for (const auto& item : g_insn_dispatch_data) {
-    insn_t d;
+  for (const auto& item : dut_events.insn_dispatch) {
+    insn_t d{}; // 值初始化：出错报告会输出 REF 未返回类型时的 ref_result
     d.pc = item.pc;
     d.insn = item.insn;
     d.extended = item.is_extended;
-    d.care = isInsnCare(item.insn, retire_care_insns);
+    d.care = isInsnCare(item.insn, CARE_RETIRE);
     d.done = 0;
     d.retired = 0;
-    d.single_insn_cmp.care = isInsnCare(item.insn, single_insn_cmp_care_insns);
+    d.single_insn_cmp.care = isInsnCare(item.insn, CARE_SINGLE_INSN_CMP);
     d.single_insn_cmp.dut_done = 0;
     d.single_insn_cmp.ref_done = 0;
     d.single_insn_cmp.cmp_pass = 0;
@@ -169,24 +289,28 @@ void gvm_t::getDutInsnDispatch() {
     }
     d.dispatch_id = item.dispatch_id;
 
-    bool found = false;
-    for (auto& warp : dut_active_warps) {
-      if (warp.second.sm_id == item.sm_id && warp.second.hardware_warp_id == item.hardware_warp_id) {
-        if (found) {
-          printf("GVM error in `gvm_t::getDutInsnDispatch`: "
-            "multiple item in `dut_active_warps` with same sm_id and hardware_warp_id\n");
-          assert(0);
-        }
-        assert(warp.second.insns.find(d.dispatch_id) == warp.second.insns.end()); // 错误：指令已被 dispatch 过一次
-        warp.second.insns[d.dispatch_id] = d;
-        found = true;
-        if (!warp.second.base_dispatch_id_set) {
-          // 设置本 warp 的首条指令的 dispatch_id
-          warp.second.base_dispatch_id = d.dispatch_id;
-          warp.second.base_dispatch_id_set = 1;
-          warp.second.next_retire_dispatch_id = d.dispatch_id;
-        }
+    dut_active_warp_t* warp = findDutWarpByHw(item.sm_id, item.hardware_warp_id);
+    if (warp != nullptr) {
+      if (!warp->checked) {
+        d.single_insn_cmp.care = false; // 未采样的 warp 只跟踪 retire，不记录 DUT 与 REF 的执行结果
+        d.single_insn_cmp.cmp_pass = 1;
+      }
+      if (!warp->base_dispatch_id_set) {
+        // 设置本 warp 的首条指令的 dispatch_id
+        warp->base_dispatch_id = d.dispatch_id;
+        warp->base_dispatch_id_set = 1;
+        warp->next_retire_dispatch_id = d.dispatch_id;
+        warp->insns_base = d.dispatch_id;
+        warp->retire_scan_dispatch_id = d.dispatch_id;
+        warp->retire_ready_dispatch_id = d.dispatch_id;
       }
+      if (d.dispatch_id != warp->insns_base + warp->insns.size()) {
+        logger->error("GVM error in `gvm_t::getDutInsnDispatch`: dispatch_id {} is not contiguous on sm_id {}, "
+          "hardware_warp_id {}, expected {}", d.dispatch_id, item.sm_id, item.hardware_warp_id,
+          warp->insns_base + warp->insns.size());
+        assert(0); // 错误：指令已被 dispatch 过一次，或跳过了 dispatch_id
+      }
+      warp->insns.push_back(d);
     }
     // 目前获取 warp 结束的标志是 endprg dispatch，
     // 但这距离 endprg 真正执行完成还有一段时间，
@@ -202,51 +326,47 @@ void gvm_t::getDutInsnFinish() {
   getDutBarDone();
 }
 void gvm_t::getDutXRegWbFinish() {
-  for (const auto& item : g_xreg_wb_data) {
-    if (!isInsnCare(item.insn, retire_care_insns)) {
+  for (const auto& item : dut_events.xreg_wb) {
+    if (!isInsnCare(item.insn, CARE_RETIRE)) {
       logger->error("GVM error in `gvm_t::getDutXRegWbFinish`: "
         "xreg writeback for instruction that does not care for retire\n"
         "getDutXRegWbFinish Error: sm_id: {}, hardware_warp_id: {}, dispatch_id: {}, pc: 0x{:08x}, insn: 0x{:08x}",
         item.sm_id, item.hardware_warp_id, item.dispatch_id, item.pc, item.insn);
     }
-    assert(isInsnCare(item.insn, retire_care_insns));
-    assert(!isInsnCare(item.insn, barrier_insns));
-    assert(!isInsnCare(item.insn, single_insn_cmp_care_insns));
-    bool found_warp = false;
-    for (auto& warp : dut_active_warps) {
-      if (warp.second.sm_id == item.sm_id && warp.second.hardware_warp_id == item.hardware_warp_id) {
-        found_warp = true;
-        auto insn_it = warp.second.insns.find(item.dispatch_id);
-        if ((insn_it != warp.second.insns.end()) && (insn_it->second.done != 1)) {
-          // 如果找到了该条指令，并且该指令尚未被标记为已完成
-          assert(insn_it->second.pc == item.pc);
-          assert(insn_it->second.insn == item.insn);
-          assert(insn_it->second.care == true); // 标量寄存器写回指令需指导 retire
-          // 维护 retire 相关变量
-          insn_it->second.done = true;
-          // 维护 single insn cmp 相关变量
-          if (insn_it->second.single_insn_cmp.care == true) {
-            insn_it->second.single_insn_cmp.dut_done = 1;
-            insn_it->second.single_insn_cmp.dut_result.insn_type = InsnType::XREG;
-            insn_it->second.single_insn_cmp.dut_result.xreg_result.rd = item.rd;
-            insn_it->second.single_insn_cmp.dut_result.xreg_result.reg_idx = item.reg_idx;
-          }
-        } else {
-          logger->debug(
-              "GVM info in `gvm_t::getDutInsnFinish`: "
-              "sm_id & hardware_warp_id match successful, but no item in this warp's unfinished "
-              "dispatched insns with required dispatch_id"
-          );
-          logger->debug(
-              "getDutInsnFinish info: sm_id: {}, hardware_warp_id: {}, dispatch_id: {}, pc: 0x{:08x}, insn: "
-              "0x{:08x}",
-              item.sm_id, item.hardware_warp_id, item.dispatch_id, item.pc, item.insn
-          );
-          // assert(0);
+    assert(isInsnCare(item.insn, CARE_RETIRE));
+    assert(!isInsnCare(item.insn, CARE_BARRIER));
+    assert(!isInsnCare(item.insn, CARE_SINGLE_INSN_CMP));
+    dut_active_warp_t* warp = findDutWarpByHw(item.sm_id, item.hardware_warp_id);
+    if (warp != nullptr) {
+      insn_t* insn = warp->findInsn(item.dispatch_id);
+      if ((insn != nullptr) && (insn->done != 1)) {
+        // 如果找到了该条指令，并且该指令尚未被标记为已完成
+        assert(insn->pc == item.pc);
+        assert(insn->insn == item.insn);
+        assert(insn->care == true); // 标量寄存器写回指令需指导 retire
+        // 维护 retire 相关变量
+        setInsnDone(*warp, *insn);
+        // 维护 single insn cmp 相关变量
+        if (insn->single_insn_cmp.care == true) {
+          insn->single_insn_cmp.dut_done = 1;
+          insn->single_insn_cmp.dut_result.insn_type = InsnType::XREG;
+          insn->single_insn_cmp.dut_result.xreg_result.rd = item.rd;
+          insn->single_insn_cmp.dut_result.xreg_result.reg_idx = item.reg_idx;
         }
+      } else {
+        logger->debug(
+            "GVM info in `gvm_t::getDutInsnFinish`: "
+            "sm_id & hardware_warp_id match successful, but no item in this warp's unfinished "
+            "dispatched insns with required dispatch_id"
+        );
+        logger->debug(
+            "getDutInsnFinish info: sm_id: {}, hardware_warp_id: {}, dispatch_id: {}, pc: 0x{:08x}, insn: "
+            "0x{:08x}",
+            item.sm_id, item.hardware_warp_id, item.dispatch_id, item.pc, item.insn
+        );
+        // assert(0);
       }
-    }
-    if (!found_warp) {
+    } else {
       // logger->error("GVM error in `gvm_t::getDutXRegWbFinish`: "
       //   "no warp in `dut_active_warps` with required sm_id and hardware_warp_id\n"
       //   "getDutXRegWbFinish Error: sm_id: {}, hardware_warp_id: {}, dispatch_id: {}, pc: 0x{:08x}, insn: 0x{:08x}",
@@ -257,73 +377,70 @@ void gvm_t::getDutXRegWbFinish() {
 }
 
 void gvm_t::getDutVRegWbFinish() {
-  for (const auto& item : g_vreg_wb_data) {
-    assert(!isInsnCare(item.second.insn, barrier_insns));
-    assert(!isInsnCare(item.second.insn, retire_care_insns));
-    if (isInsnCare(item.second.insn, single_insn_cmp_care_insns)) {
-      bool found_warp = false;
-      for (auto& warp : dut_active_warps) {
-        if ((warp.second.sm_id == item.second.sm_id) && (warp.second.hardware_warp_id == item.second.hardware_warp_id)) {
-          found_warp = true;
-          auto insn_it = warp.second.insns.find(item.second.dispatch_id);
-          if (insn_it != warp.second.insns.end() && (insn_it->second.single_insn_cmp.dut_done != 1)) {
-            // 如果找到了该条指令，并且该指令尚未被标记为已完成
-            assert(insn_it->second.pc == item.second.pc);
-            assert(insn_it->second.insn == item.second.insn);
-            assert(insn_it->second.care == false); // 向量寄存器写回指令不参与 retire
-            // 维护 single insn cmp 相关变量
-            if (insn_it->second.single_insn_cmp.care == true) {
-              insn_it->second.single_insn_cmp.dut_done = 1;
-              insn_it->second.single_insn_cmp.dut_result.insn_type = InsnType::VREG;
-              insn_it->second.single_insn_cmp.dut_result.vreg_result.rd = item.second.rd_data;
-              insn_it->second.single_insn_cmp.dut_result.vreg_result.reg_idx = item.second.reg_idx;
-              insn_it->second.single_insn_cmp.dut_result.vreg_result.mask = item.second.wvd_mask;
-            }
-          } else {
-            logger->debug(
-                "GVM info in `gvm_t::getDutVRegWbFinish`: "
-                "sm_id & hardware_warp_id match successful, but no item in this warp's unfinished "
-                "dispatched insns with required dispatch_id"
-            );
-            logger->debug(
-                "getDutVRegWbFinish info: sm_id: {}, hardware_warp_id: {}, dispatch_id: {}, pc: 0x{:08x}, insn: 0x{:08x}",
-                item.second.sm_id, item.second.hardware_warp_id, item.second.dispatch_id, item.second.pc, item.second.insn
-            );
-            // assert(0);
+  for (const auto& item : dut_events.vreg_wb) {
+    assert(!isInsnCare(item.insn, CARE_BARRIER));
+    assert(!isInsnCare(item.insn, CARE_RETIRE));
+    if (isInsnCare(item.insn, CARE_SINGLE_INSN_CMP)) {
+      dut_active_warp_t* warp = findDutWarpByHw(item.sm_id, item.hardware_warp_id);
+      if (warp != nullptr) {
+        insn_t* insn = warp->findInsn(item.dispatch_id);
+        if (insn != nullptr && (insn->single_insn_cmp.dut_done != 1)) {
+          // 如果找到了该条指令，并且该指令尚未被标记为已完成
+          assert(insn->pc == item.pc);
+          assert(insn->insn == item.insn);
+          assert(insn->care == false); // 向量寄存器写回指令不参与 retire
+          // 维护 single insn cmp 相关变量
+          if (insn->single_insn_cmp.care == true) {
+            insn->single_insn_cmp.dut_done = 1;
+            insn->single_insn_cmp.dut_result.insn_type = InsnType::VREG;
+            insn->single_insn_cmp.dut_result.vreg_result.rd = item.rd_data;
+            insn->single_insn_cmp.dut_result.vreg_result.reg_idx = item.reg_idx;
+            insn->single_insn_cmp.dut_result.vreg_result.mask = item.wvd_mask;
           }
+        } else {
+          logger->debug(
+              "GVM info in `gvm_t::getDutVRegWbFinish`: "
+              "sm_id & hardware_warp_id match successful, but no item in this warp's unfinished "
+              "dispatched insns with required dispatch_id"
+          );
+          logger->debug(
+              "getDutVRegWbFinish info: sm_id: {}, hardware_warp_id: {}, dispatch_id: {}, pc: 0x{:08x}, insn: 0x{:08x}",
+              item.sm_id, item.hardware_warp_id, item.dispatch_id, item.pc, item.insn
+          );
+          // assert(0);
         }
-      }
-      if (!found_warp) {
+      } else {
         // logger->error("GVM error in `gvm_t::getDutVRegWbFinish`: "
         //   "no warp in `dut_active_warps` with required sm_id and hardware_warp_id\n"
         //   "getDutVRegWbFinish Error: sm_id: {}, hardware_warp_id: {}, dispatch_id: {}, pc: 0x{:08x}, insn: 0x{:08x}",
-        //   item.second.sm_id, item.second.hardware_warp_id, item.second.dispatch_id, item.second.pc, item.second.insn);
+        //   item.sm_id, item.hardware_warp_id, item.dispatch_id, item.pc, item.insn);
         // assert(0);
       }
     } else {
       logger->debug("GVM warning in `gvm_t::getDutVRegWbFinish`: "
         "ignoring VReg Writeback from pc 0x{:08x}, insn 0x{:08x}",
-        item.second.pc, item.second.insn);
+        item.pc, item.insn);
     }
   }
 }
 
 void gvm_t::getDutBarDone() {
-  for (const auto& item : g_bar_done_data) {
-    assert(isInsnCare(item.insn, barrier_insns));
-    if(isInsnCare(item.insn, single_insn_cmp_care_insns)){
-      char buffer[128];
-      disasm(item.insn, buffer);
-      printf("%s\n", buffer);
+  for (const auto& item : dut_events.bar_done) {
+    assert(isInsnCare(item.insn, CARE_BARRIER));
+    if(isInsnCare(item.insn, CARE_SINGLE_INSN_CMP)){
+      printf("%s\n", disasm(item.insn));
       assert(0);
     } // barrier 指令不参与单指令比对
-    assert(isInsnCare(item.insn, retire_care_insns)); // barrier 指令需指导 retire
+    assert(isInsnCare(item.insn, CARE_RETIRE)); // barrier 指令需指导 retire
     bool found = false;
-    for (auto& warp: dut_active_warps) {
-      if (warp.second.sm_id == item.sm_id && warp.second.wg_slot_id_in_warp_sche == item.wg_slot_id) {
-        for (auto& insn: warp.second.insns) {
-          if (insn.second.pc == item.pc) {
-            if(insn.second.done == false) {
+    // 只需遍历该 SM 上的 warp
+    static const std::vector<dut_active_warp_t*> no_warps;
+    const auto& sm_warps = item.sm_id < dut_warps_by_hw.size() ? dut_warps_by_hw[item.sm_id] : no_warps;
+    for (dut_active_warp_t* warp : sm_warps) {
+      if (warp != nullptr && warp->wg_slot_id_in_warp_sche == item.wg_slot_id) {
+        for (auto& insn: warp->insns) {
+          if (insn.pc == item.pc) {
+            if(insn.done == false) {
               found = true;
             }
             // 为什么这里不用 dispatch_id 来识别指令？因为各个 warp 的分支行为可能不同
@@ -331,8 +448,8 @@ void gvm_t::getDutBarDone() {
             // 而这里拿到的 dispatch_id 只是最后一个完成的 warp 的 dispatch_id
             // 因此使用 pc 识别 barrier 指令
             // 激进地假设不会同时存在两个相同 pc 的未 retire 的 barrier 指令
-            assert(insn.second.care == true); // barrier 指令需指导 retire
-            insn.second.done = true; // 标记该指令已完成
+            assert(insn.care == true); // barrier 指令需指导 retire
+            setInsnDone(*warp, insn); // 标记该指令已完成
           }
         }
       }
@@ -347,27 +464,26 @@ void gvm_t::getDutBarDone() {
   }
 }
 
-void gvm_t::getDutXReg() {
-  // 从交织的寄存器板块中，提取每个 warp 各自的寄存器
-  std::map<uint32_t, std::map<uint32_t, XRegData>> g_xreg_data_mapped;
-  assert(!g_xreg_data.empty());
-  for (const auto& item : g_xreg_data) {
-    g_xreg_data_mapped[item.sm_id][item.bank_id] = item;
+void gvm_t::getDutXReg(dut_active_warp_t& warp) {
+  // 从交织的寄存器板块中，提取这个 warp 的寄存器
+  if (xreg_from_events && (warp.sm_id >= dut_events.xregs.size() || !dut_events.xregs[warp.sm_id].captured)) {
+    logger->error("GVM error in `gvm_t::getDutXReg`: xreg of sm_id {} was not captured at time {}",
+      warp.sm_id, dut_events.time);
+    assert(0);
   }
-  for (auto& warp : dut_active_warps) {
-    warp.second.curr_xreg.resize(warp.second.xreg_usage);
-    // 将这个 warp 的寄存器从交织的板块中提取出来
-    uint32_t num_bank = g_xreg_data_mapped[warp.second.sm_id].begin()->second.num_bank;
-    assert((num_bank & (num_bank - 1)) == 0); // 断言 num_bank 是 2 的幂
-    // 断言 warp 的寄存器是对齐到板块个数的
-    assert(warp.second.xreg_base % num_bank == 0);
-    assert(warp.second.xreg_usage % num_bank == 0);
-    for (int i = 0; i < warp.second.xreg_usage; ++i) {
-      warp.second.curr_xreg[i] = g_xreg_data_mapped[warp.second.sm_id]
-        [(i + warp.second.hardware_warp_id) % num_bank].bank_data[(warp.second.xreg_base + i) >> __builtin_ctz(num_bank)];
-    }
-    warp.second.curr_xreg[0] = 0; // 强制 x0 为 0，认为 DUT 已经正确地对 x0 做了特殊处理
+  const XRegData& xreg = xreg_from_events ? dut_events.xregs[warp.sm_id] : gvm_dut_xreg_capture(warp.sm_id);
+  uint32_t num_bank = xreg.num_bank;
+  uint32_t bank_depth = xreg.num_sgpr_slots / num_bank;
+  assert((num_bank & (num_bank - 1)) == 0); // 断言 num_bank 是 2 的幂
+  // 断言 warp 的寄存器是对齐到板块个数的
+  assert(warp.xreg_base % num_bank == 0);
+  assert(warp.xreg_usage % num_bank == 0);
+  warp.curr_xreg.resize(warp.xreg_usage);
+  for (int i = 0; i < warp.xreg_usage; ++i) {
+    warp.curr_xreg[i] = xreg.xbanks[((i + warp.hardware_warp_id) % num_bank) * bank_depth
+      + ((warp.xreg_base + i) >> __builtin_ctz(num_bank))];
   }
+  warp.curr_xreg[0] = 0; // 强制 x0 为 0，认为 DUT 已经正确地对 x0 做了特殊处理
 }
 
 void gvm_t::getDutWarpNewSetRefXReg() {
@@ -376,7 +492,7 @@ void gvm_t::getDutWarpNewSetRefXReg() {
   // 但 RTL DUT 的 CTA 调度器在向 SM 分派新 warp 时，只会在寄存器堆中分配一块空间，但不会零初始化；
   // 导致大量寄存器不匹配。
   // 因此这里在 DUT 的 CTA 调度器向 SM 分派新 warp 时，将 DUT 的该 warp 的寄存器数据同步到 REF 的对应 warp。
-  for (const auto& item : g_cta2warp_data) {
+  for (const auto& item : dut_events.cta2warp) {
     auto warp_it = dut_active_warps.find({ item.software_wg_id, item.software_warp_id });
     if (warp_it == dut_active_warps.end()) {
       logger->error("GVM error in `gvm_t::getDutWarpNewSetRefXReg`: "
@@ -385,26 +501,19 @@ void gvm_t::getDutWarpNewSetRefXReg() {
         item.software_wg_id, item.software_warp_id);
       assert(0);
     }
-    auto &warp = warp_it->second;
-
-    gvmref_warp_xreg_t xreg_data;
-    xreg_data.xreg.resize(warp.xreg_usage);
-    for (uint32_t i = 0; i < warp.xreg_usage; ++i) {
-      xreg_data.xreg[i] = warp.curr_xreg[i];
-    }
-    gvmref_set_warp_xreg(item.software_wg_id, item.software_warp_id, warp.xreg_usage, xreg_data);
+    setRefXReg(warp_it->second);
   }
 }
 
-void gvm_t::clearGlobal() {
-  // 清空全局变量
-  g_cta2warp_data.clear();
-  g_insn_dispatch_data.clear();
-  // g_sgprUsage.clear();
-  g_xreg_wb_data.clear();
-  g_xreg_data.clear();
-  g_vreg_wb_data.clear();
-  g_bar_done_data.clear();
+void gvm_t::setRefXReg(dut_active_warp_t& warp) {
+  getDutXReg(warp);
+
+  gvmref_warp_xreg_t xreg_data;
+  xreg_data.xreg.resize(warp.xreg_usage);
+  for (uint32_t i = 0; i < warp.xreg_usage; ++i) {
+    xreg_data.xreg[i] = warp.curr_xreg[i];
+  }
+  gvmref_set_warp_xreg(warp.software_wg_id, warp.software_warp_id, warp.xreg_usage, xreg_data);
 }
 
 //
@@ -422,70 +531,79 @@ int gvm_t::gvmStep() {
 }
 
 
-void gvm_t::checkRetire() {
-  for (auto& warp: dut_active_warps) {
-    auto it = warp.second.insns.find(warp.second.next_retire_dispatch_id);
-    assert(it == warp.second.insns.end() || it->second.retired == false);
+void gvm_t::setInsnDone(dut_active_warp_t& warp, insn_t& insn) {
+  if (insn.done) {
+    return;
+  }
+  insn.done = true;
+  // 扫描尚未到达的已完成指令是乱序完成的，计数，扫描经过时再减去
+  if (insn.care && warp.insnIndex(insn.dispatch_id) >= warp.insnIndex(warp.retire_scan_dispatch_id)) {
+    warp.num_done_beyond_scan++;
+  }
+}
 
-    if (it == warp.second.insns.end()) {
+void gvm_t::checkRetire() {
+  // 每个 warp 从上次停下的位置继续扫描，每条指令只被扫描一次；乱序完成的指令在 setInsnDone() 中计数，不需要再次遍历
+  for (auto& [key, warp]: dut_active_warps) {
+    if (!warp.base_dispatch_id_set) {
       continue;
     }
+    const insn_t* first = warp.findInsn(warp.next_retire_dispatch_id);
+    assert(first == nullptr || first->retired == false);
 
-    auto insn_it_begin = it;
-    uint32_t final_cnt = 0;
-    uint32_t temp_retire_cnt = 0;
-    bool barriered = false;
-    for (; it != warp.second.insns.end(); ++it) {
-      if (it->second.care == false) {
-        assert(isInsnCare(it->second.insn, barrier_insns) == false);
-        temp_retire_cnt++;
-      } else if (it->second.done == true) {
-        final_cnt += temp_retire_cnt;
-        temp_retire_cnt = 0;
-        final_cnt++;
-        if(isInsnCare(it->second.insn, barrier_insns)) {
-          barriered = true;
-          break;
-        }
-      } else {
-        break;
-      }
+    if (warp.retire_scan_barriered && warp.next_retire_dispatch_id == warp.retire_scan_dispatch_id) {
+      warp.retire_scan_barriered = false; // 上次停下处的 barrier 已经 retire
     }
-    ++it;
-    bool retiring = true;
-    for (; it != warp.second.insns.end(); ++it) {
-      if (barriered) {
-        assert(it->second.care == false || it->second.done == false); // RTL 中，不应当有指令越过 barrier 完成
+    while (!warp.retire_scan_barriered) {
+      const insn_t* insn = warp.findInsn(warp.retire_scan_dispatch_id);
+      if (insn == nullptr) {
+        break;
       }
-      else if (it->second.care == true && it->second.done == true) {
-        retiring = false;
+      if (insn->care == false) {
+        assert(isInsnCare(insn->insn, CARE_BARRIER) == false);
+      } else if (insn->done == true) {
+        assert(warp.num_done_beyond_scan > 0);
+        warp.num_done_beyond_scan--;
+        warp.retire_ready_dispatch_id = warp.retire_scan_dispatch_id + 1;
+        warp.retire_scan_barriered = isInsnCare(insn->insn, CARE_BARRIER);
+      } else {
         break;
       }
+      warp.retire_scan_dispatch_id++;
+    }
+
+    if (warp.retire_scan_barriered) {
+      assert(warp.num_done_beyond_scan == 0); // RTL 中，不应当有指令越过 barrier 完成
+    } else if (warp.num_done_beyond_scan > 0) {
+      continue; // 有关心的指令越过未完成的指令乱序完成，等待前面的指令完成后再一起 retire
     }
-    if (final_cnt == 0 || retiring == false) {
+    const uint32_t final_cnt = warp.retire_ready_dispatch_id - warp.next_retire_dispatch_id;
+    if (final_cnt == 0) {
       continue;
     }
     retireInfo_t::retire_cnt_item_t r;
-    r.sm_id = warp.second.sm_id;
-    r.hardware_warp_id = warp.second.hardware_warp_id;
-    r.software_wg_id = warp.second.software_wg_id;
-    r.software_warp_id = warp.second.software_warp_id;
+    r.sm_id = warp.sm_id;
+    r.hardware_warp_id = warp.hardware_warp_id;
+    r.software_wg_id = warp.software_wg_id;
+    r.software_warp_id = warp.software_warp_id;
     r.retire_cnt = final_cnt;
-    r.barrier_included = barriered;
+    r.barrier_included = warp.retire_scan_barriered;
     r.barrier_retry = false;
     retire_info.warp_retire_cnt.push_back(r);
 
+    if (!logger->should_log(spdlog::level::debug)) {
+      continue;
+    }
     logger->debug(fmt::format("GVM retire message from gvm_t::checkRetire()"));
 
     // 打印 retire log（遍历最终 retire 的那一段）
-    auto print_it = insn_it_begin;
-    for (uint32_t i = 0; i < final_cnt && print_it != warp.second.insns.end(); ++i, ++print_it) {
-      char insn_name[64];
-      disasm(print_it->second.insn, insn_name);
+    for (uint32_t i = 0; i < final_cnt; ++i) {
+      const insn_t& insn = *warp.findInsn(warp.next_retire_dispatch_id + i);
+      const char* insn_name = disasm(insn.insn);
       logger->debug(fmt::format(
         "GVM retire: sm_id: {}, hardware_warp_id: {}, software_wg_id: {}, software_warp_id: {}, dispatch_id: {}, pc: 0x{:08x}, insn: 0x{:08x} {}",
-        warp.second.sm_id, warp.second.hardware_warp_id, warp.second.software_wg_id,
-        warp.second.software_warp_id, print_it->second.dispatch_id, print_it->second.pc, print_it->second.insn, insn_name
+        warp.sm_id, warp.hardware_warp_id, warp.software_wg_id,
+        warp.software_warp_id, insn.dispatch_id, insn.pc, insn.insn, insn_name
       ));
     }
   }
@@ -502,7 +620,8 @@ void gvm_t::stepRef() {
     for (int i=0; i<item.retire_cnt; i++) {
       gvmref_step_return_info_t gvmref_step_return_info;
 
-      auto& cur_insn = warp_it->second.insns[warp_it->second.next_retire_dispatch_id];
+      assert(warp_it->second.findInsn(warp_it->second.next_retire_dispatch_id) != nullptr);
+      auto& cur_insn = *warp_it->second.findInsn(warp_it->second.next_retire_dispatch_id);
 
       if (cur_insn.extended) {
         gvmref_step(item.software_wg_id, item.software_warp_id, &gvmref_step_return_info); // 跳过 regext
@@ -516,6 +635,8 @@ void gvm_t::stepRef() {
       if (next_dut_pc != next_gvmref_pc) {
         logger->error(fmt::format("GVM error: DUT and REF next PC mismatch on sm_id: {}, hardware_warp_id: {}, software_wg_id: {}, software_warp_id: {}. DUT next PC: 0x{:08x}, REF next PC: 0x{:08x}",
           item.sm_id, item.hardware_warp_id, item.software_wg_id, item.software_warp_id, next_dut_pc, next_gvmref_pc));
+        reportDivergence(warp_it->second, "pc_mismatch", &cur_insn,
+          fmt::format("\"dut_pc\":\"0x{:08x}\",\"ref_pc\":\"0x{:08x}\"", next_dut_pc, next_gvmref_pc));
       }
       assert(next_dut_pc == next_gvmref_pc);
 
@@ -525,7 +646,7 @@ void gvm_t::stepRef() {
       if (next2_gvmref_pc == next_gvmref_pc) {
         logger->debug(fmt::format("GVM info: REF PC not advanced after step on sm_id: {}, hardware_warp_id: {}, software_wg_id: {}, software_warp_id: {}. REF next PC before step: 0x{:08x}, after step: 0x{:08x}",
           item.sm_id, item.hardware_warp_id, item.software_wg_id, item.software_warp_id, next_gvmref_pc, next2_gvmref_pc));
-        if (isInsnCare(cur_insn.insn, barrier_insns)) {
+        if (isInsnCare(cur_insn.insn, CARE_BARRIER)) {
           assert(item.barrier_retry == false); // barrier_retry 应当只被置一次
           item.barrier_retry = true; // 该 warp 包含 barrier 指令，且 REF PC 未前进，标记 barrier_retry
         }
@@ -581,7 +702,8 @@ void gvm_t::stepRef() {
 
     if (item.barrier_included && item.barrier_retry) {
       gvmref_step_return_info_t gvmref_step_return_info;
-      auto& cur_insn = warp_it->second.insns[warp_it->second.next_retire_dispatch_id];
+      assert(warp_it->second.findInsn(warp_it->second.next_retire_dispatch_id) != nullptr);
+      auto& cur_insn = *warp_it->second.findInsn(warp_it->second.next_retire_dispatch_id);
       assert(!cur_insn.extended);
 
       // 确认 DUT 与 REF 的 PC 一致
@@ -592,6 +714,8 @@ void gvm_t::stepRef() {
       if (next_dut_pc != next_gvmref_pc) {
         logger->error(fmt::format("GVM error: DUT and REF next PC mismatch on sm_id: {}, hardware_warp_id: {}, software_wg_id: {}, software_warp_id: {}. DUT next PC: 0x{:08x}, REF next PC: 0x{:08x}",
           item.sm_id, item.hardware_warp_id, item.software_wg_id, item.software_warp_id, next_dut_pc, next_gvmref_pc));
+        reportDivergence(warp_it->second, "pc_mismatch", &cur_insn,
+          fmt::format("\"dut_pc\":\"0x{:08x}\",\"ref_pc\":\"0x{:08x}\"", next_dut_pc, next_gvmref_pc));
       }
       assert(next_dut_pc == next_gvmref_pc);
 
@@ -620,102 +744,105 @@ int gvm_t::doSingleInsnCmp() {
   // assert(0);
   for (auto warpIt = dut_active_warps.begin(); warpIt != dut_active_warps.end(); ++warpIt) {
     for (auto insnIt = warpIt->second.insns.begin(); insnIt != warpIt->second.insns.end(); ++insnIt) {
-      if (insnIt->second.single_insn_cmp.care) {
-        if (insnIt->second.single_insn_cmp.dut_done && insnIt->second.single_insn_cmp.ref_done) {
-          switch (insnIt->second.single_insn_cmp.dut_result.insn_type) {
+      if (insnIt->single_insn_cmp.care) {
+        if (insnIt->single_insn_cmp.dut_done && insnIt->single_insn_cmp.ref_done) {
+          switch (insnIt->single_insn_cmp.dut_result.insn_type) {
             case InsnType::XREG: {
-              assert(insnIt->second.single_insn_cmp.ref_result.insn_type == InsnType::XREG);
-              if ((insnIt->second.single_insn_cmp.dut_result.xreg_result.rd
-                != insnIt->second.single_insn_cmp.ref_result.xreg_result.rd)
-                || (insnIt->second.single_insn_cmp.dut_result.xreg_result.reg_idx
-                != insnIt->second.single_insn_cmp.ref_result.xreg_result.reg_idx)) {
+              assert(insnIt->single_insn_cmp.ref_result.insn_type == InsnType::XREG);
+              if ((insnIt->single_insn_cmp.dut_result.xreg_result.rd
+                != insnIt->single_insn_cmp.ref_result.xreg_result.rd)
+                || (insnIt->single_insn_cmp.dut_result.xreg_result.reg_idx
+                != insnIt->single_insn_cmp.ref_result.xreg_result.reg_idx)) {
                 logger->error(fmt::format(
                   "GVM error: DUT and REF insn result mismatch at sm_id {}, hardware_warp_id {}, software_wg_id {}, software_warp_id {}, dispatch_id {}, pc 0x{:08x}, insn 0x{:08x}"
                   "insn_type XREG, DUT reg_idx: {}, REF reg_idx: {}, DUT rd: 0x{:08x}, REF rd: 0x{:08x}",
                   warpIt->second.sm_id, warpIt->second.hardware_warp_id, warpIt->second.software_wg_id,
-                  warpIt->second.software_warp_id, insnIt->second.dispatch_id, insnIt->second.pc, insnIt->second.insn,
-                  insnIt->second.single_insn_cmp.dut_result.xreg_result.reg_idx,
-                  insnIt->second.single_insn_cmp.ref_result.xreg_result.reg_idx,
-                  insnIt->second.single_insn_cmp.dut_result.xreg_result.rd,
-                  insnIt->second.single_insn_cmp.ref_result.xreg_result.rd
+                  warpIt->second.software_warp_id, insnIt->dispatch_id, insnIt->pc, insnIt->insn,
+                  insnIt->single_insn_cmp.dut_result.xreg_result.reg_idx,
+                  insnIt->single_insn_cmp.ref_result.xreg_result.reg_idx,
+                  insnIt->single_insn_cmp.dut_result.xreg_result.rd,
+                  insnIt->single_insn_cmp.ref_result.xreg_result.rd
                 ));
-                insnIt->second.single_insn_cmp.cmp_pass = -1;
+                insnIt->single_insn_cmp.cmp_pass = -1;
               } else {
-                insnIt->second.single_insn_cmp.cmp_pass = 1;
+                insnIt->single_insn_cmp.cmp_pass = 1;
               }
               break;
             }
             case InsnType::VREG: {
-              assert(insnIt->second.single_insn_cmp.ref_result.insn_type == InsnType::VREG);
+              assert(insnIt->single_insn_cmp.ref_result.insn_type == InsnType::VREG);
               bool mask_same = std::equal(
-                insnIt->second.single_insn_cmp.dut_result.vreg_result.mask.begin(),
-                insnIt->second.single_insn_cmp.dut_result.vreg_result.mask.begin() + warpIt->second.num_thread,
-                insnIt->second.single_insn_cmp.ref_result.vreg_result.mask.begin()
+                insnIt->single_insn_cmp.dut_result.vreg_result.mask.begin(),
+                insnIt->single_insn_cmp.dut_result.vreg_result.mask.begin() + warpIt->second.num_thread,
+                insnIt->single_insn_cmp.ref_result.vreg_result.mask.begin()
               );
-              if ((insnIt->second.single_insn_cmp.dut_result.vreg_result.mask
-                != insnIt->second.single_insn_cmp.ref_result.vreg_result.mask)
+              if ((insnIt->single_insn_cmp.dut_result.vreg_result.mask
+                != insnIt->single_insn_cmp.ref_result.vreg_result.mask)
                 || (!mask_same))
               {
                 logger->error(fmt::format(
                   "GVM error: DUT and REF vreg insn result writeback mask or reg_idx mismatch at sm_id {}, hardware_warp_id {}, software_wg_id {}, software_warp_id {}, dispatch_id {}, pc 0x{:08x}, insn 0x{:08x}, "
                   "insn_type VREG, DUT reg_idx: {}, REF reg_idx: {}, DUT mask: {}, REF mask: {}, DUT reg_idx: {}, REF reg_idx: {}",
                   warpIt->second.sm_id, warpIt->second.hardware_warp_id, warpIt->second.software_wg_id,
-                  warpIt->second.software_warp_id, insnIt->second.dispatch_id, insnIt->second.pc, insnIt->second.insn,
-                  insnIt->second.single_insn_cmp.dut_result.vreg_result.reg_idx,
-                  insnIt->second.single_insn_cmp.ref_result.vreg_result.reg_idx,
-                  mask_to_string(insnIt->second.single_insn_cmp.dut_result.vreg_result.mask, warpIt->second.num_thread),
-                  mask_to_string(insnIt->second.single_insn_cmp.ref_result.vreg_result.mask, warpIt->second.num_thread),
-                  insnIt->second.single_insn_cmp.dut_result.vreg_result.reg_idx,
-                  insnIt->second.single_insn_cmp.ref_result.vreg_result.reg_idx
+                  warpIt->second.software_warp_id, insnIt->dispatch_id, insnIt->pc, insnIt->insn,
+                  insnIt->single_insn_cmp.dut_result.vreg_result.reg_idx,
+                  insnIt->single_insn_cmp.ref_result.vreg_result.reg_idx,
+                  mask_to_string(insnIt->single_insn_cmp.dut_result.vreg_result.mask, warpIt->second.num_thread),
+                  mask_to_string(insnIt->single_insn_cmp.ref_result.vreg_result.mask, warpIt->second.num_thread),
+                  insnIt->single_insn_cmp.dut_result.vreg_result.reg_idx,
+                  insnIt->single_insn_cmp.ref_result.vreg_result.reg_idx
                 ));
-                insnIt->second.single_insn_cmp.cmp_pass = -1;
+                insnIt->single_insn_cmp.cmp_pass = -1;
               } else {
-                bool is_fp32 = isInsnCare(insnIt->second.insn, fp32_vreg_insns);
+                bool is_fp32 = isInsnCare(insnIt->insn, CARE_FP32_VREG);
                 for (int i = 0; i < warpIt->second.num_thread; i++) {
-                  if (insnIt->second.single_insn_cmp.dut_result.vreg_result.mask[i]) {
+                  if (insnIt->single_insn_cmp.dut_result.vreg_result.mask[i]) {
                     if (is_fp32) {
-                      float dut_value = *reinterpret_cast<float*>(&insnIt->second.single_insn_cmp.dut_result.vreg_result.rd[i]);
-                      float ref_value = *reinterpret_cast<float*>(&insnIt->second.single_insn_cmp.ref_result.vreg_result.rd[i]);
+                      float dut_value = *reinterpret_cast<float*>(&insnIt->single_insn_cmp.dut_result.vreg_result.rd[i]);
+                      float ref_value = *reinterpret_cast<float*>(&insnIt->single_insn_cmp.ref_result.vreg_result.rd[i]);
                       if (std::abs(dut_value - ref_value) > fp32_atol + fp32_rtol * std::abs(ref_value)) {
                         logger->error(fmt::format(
                           "GVM error: DUT and REF vreg-float mismatch at sm_id {}, hardware_warp_id {}, software_wg_id {}, software_warp_id {}, dispatch_id {}, pc 0x{:08x}, insn 0x{:08x}, "
                           "vreg_idx {}, vec_element_idx {}, DUT value: {}, REF value: {}",
                           warpIt->second.sm_id, warpIt->second.hardware_warp_id, warpIt->second.software_wg_id, warpIt->second.software_warp_id,
-                          insnIt->second.dispatch_id, insnIt->second.pc, insnIt->second.insn,
-                          insnIt->second.single_insn_cmp.dut_result.vreg_result.reg_idx,
+                          insnIt->dispatch_id, insnIt->pc, insnIt->insn,
+                          insnIt->single_insn_cmp.dut_result.vreg_result.reg_idx,
                           i, dut_value, ref_value
                         ));
-                        insnIt->second.single_insn_cmp.cmp_pass = -1;
+                        insnIt->single_insn_cmp.cmp_pass = -1;
                       }
                     } else {
-                      if (insnIt->second.single_insn_cmp.dut_result.vreg_result.rd[i]
-                        != insnIt->second.single_insn_cmp.ref_result.vreg_result.rd[i]) {
+                      if (insnIt->single_insn_cmp.dut_result.vreg_result.rd[i]
+                        != insnIt->single_insn_cmp.ref_result.vreg_result.rd[i]) {
                         logger->error(fmt::format(
                           "GVM error: DUT and REF vreg mismatch at sm_id {}, hardware_warp_id {}, software_wg_id {}, software_warp_id {}, dispatch_id {}, pc 0x{:08x}, insn 0x{:08x}, "
                           "vreg_idx {}, vec_element_idx {}, DUT value: 0x{:08x}, REF value: 0x{:08x}",
                           warpIt->second.sm_id, warpIt->second.hardware_warp_id, warpIt->second.software_wg_id, warpIt->second.software_warp_id,
-                          insnIt->second.dispatch_id, insnIt->second.pc, insnIt->second.insn,
-                          insnIt->second.single_insn_cmp.dut_result.vreg_result.reg_idx,
+                          insnIt->dispatch_id, insnIt->pc, insnIt->insn,
+                          insnIt->single_insn_cmp.dut_result.vreg_result.reg_idx,
                           i,
-                          insnIt->second.single_insn_cmp.dut_result.vreg_result.rd[i],
-                          insnIt->second.single_insn_cmp.ref_result.vreg_result.rd[i]
+                          insnIt->single_insn_cmp.dut_result.vreg_result.rd[i],
+                          insnIt->single_insn_cmp.ref_result.vreg_result.rd[i]
                         ));
-                        insnIt->second.single_insn_cmp.cmp_pass = -1;
+                        insnIt->single_insn_cmp.cmp_pass = -1;
                       }
                     }
                   }
                 }
-                if (insnIt->second.single_insn_cmp.cmp_pass == 0) {
-                  insnIt->second.single_insn_cmp.cmp_pass = 1; // 比对通过
+                if (insnIt->single_insn_cmp.cmp_pass == 0) {
+                  insnIt->single_insn_cmp.cmp_pass = 1; // 比对通过
                 }
               }
               break;
             }
             default: {
-              insnIt->second.single_insn_cmp.cmp_pass = -2; // unknown insn type
+              insnIt->single_insn_cmp.cmp_pass = -2; // unknown insn type
               break;
             }
           }
+          if (insnIt->single_insn_cmp.cmp_pass == -1) {
+            reportDivergence(warpIt->second, "insn_result_mismatch", &*insnIt, "");
+          }
         }
       }
     }
@@ -726,8 +853,13 @@ int gvm_t::doSingleInsnCmp() {
 int gvm_t::doRetireCmp() {
   gvmref_xreg_t gvmref_xreg;
   for (const auto& item : retire_info.warp_retire_cnt) {    
-  gvmref_get_xreg(&gvmref_xreg, item.software_wg_id, item.software_warp_id);
     auto& warp = dut_active_warps[{item.software_wg_id, item.software_warp_id}];
+    if (!warp.checked) {
+      continue; // 未采样的 warp 不比对寄存器堆
+    }
+  gvmref_get_xreg(&gvmref_xreg, item.software_wg_id, item.software_warp_id);
+    getDutXReg(warp);
+    std::string detail; // 出错时才格式化
     for (int i=0; i<warp.xreg_usage; i++) {
       if (static_cast<uint32_t>(gvmref_xreg.xpr[i]) != warp.curr_xreg[i]) {
         logger->error(fmt::format(
@@ -736,26 +868,289 @@ int gvm_t::doRetireCmp() {
           warp.curr_xreg[i],
           static_cast<uint32_t>(gvmref_xreg.xpr[i])
         ));
+        detail += fmt::format("{}{{\"reg\":{},\"dut\":\"0x{:08x}\",\"ref\":\"0x{:08x}\"}}",
+          detail.empty() ? "" : ",", i, warp.curr_xreg[i], static_cast<uint32_t>(gvmref_xreg.xpr[i]));
       }
     }
+    if (!detail.empty()) {
+      // 寄存器堆在本周期 retire 的指令之后比对，出错的指令是 history 中最近的几条之一
+      const insn_t* last = warp.findInsn(warp.next_retire_dispatch_id - 1);
+      reportDivergence(warp, "xreg_mismatch", last, "\"xregs\":[" + detail + "]");
+    }
   }
   return 0;
 }
 
 void gvm_t::clearInsnItem() {
   for (auto& warp: dut_active_warps) {
-    for (auto insn_it = warp.second.insns.begin(); insn_it != warp.second.insns.end(); ) {
-      if ((insn_it->second.single_insn_cmp.cmp_pass != 0)
-        && (insn_it->second.retired == true)) {
-        insn_it = warp.second.insns.erase(insn_it);
-      }
-      else {
-        break;
-      }
+    auto& insns = warp.second.insns;
+    while (!insns.empty() && (insns.front().single_insn_cmp.cmp_pass != 0) && (insns.front().retired == true)) {
+      warp.second.pushHistory(dut_events.time, insns.front());
+      insns.pop_front();
+      warp.second.insns_base++;
     }
   }
 }
 
 void gvm_t::resetRetireInfo() {
   retire_info.warp_retire_cnt.clear();
-}
\ No newline at end of file
+}
+
+//
+// ------------------------- gvm_t::reportDivergence() ----------------------------------------------
+//
+
+static std::string insn_result_to_json(const insn_result_t& r, bool valid, uint32_t num_thread) {
+  if (!valid) {
+    return "null";
+  }
+  switch (r.insn_type) {
+    case InsnType::XREG:
+      return fmt::format("{{\"type\":\"xreg\",\"reg_idx\":{},\"rd\":\"0x{:08x}\"}}",
+        r.xreg_result.reg_idx, r.xreg_result.rd);
+    case InsnType::VREG: {
+      std::string rd;
+      for (uint32_t i = 0; i < num_thread; i++) {
+        rd += fmt::format("{}\"0x{:08x}\"", i == 0 ? "" : ",", r.vreg_result.rd[i]);
+      }
+      return fmt::format("{{\"type\":\"vreg\",\"reg_idx\":{},\"mask\":\"{}\",\"rd\":[{}]}}",
+        r.vreg_result.reg_idx, mask_to_string(r.vreg_result.mask, num_thread), rd);
+    }
+    default:
+      return "{\"type\":\"none\"}";
+  }
+}
+
+static std::string insn_to_json(const insn_t& insn, uint32_t num_thread) {
+  std::string name = gvm_t::disasm(insn.insn);
+  name.erase(name.find_last_not_of(' ') + 1); // 反汇编名称以空格补齐
+  const single_insn_cmp_t& cmp = insn.single_insn_cmp;
+  return fmt::format(
+    "{{\"dispatch_id\":{},\"pc\":\"0x{:08x}\",\"insn\":\"0x{:08x}\",\"name\":\"{}\",\"done\":{},\"retired\":{},"
+    "\"cmp_pass\":{},\"dut\":{},\"ref\":{}}}",
+    insn.dispatch_id, insn.pc, insn.insn, name, insn.done, insn.retired, cmp.cmp_pass,
+    insn_result_to_json(cmp.dut_result, cmp.care && cmp.dut_done, num_thread),
+    insn_result_to_json(cmp.ref_result, cmp.care && cmp.ref_done, num_thread));
+}
+
+void gvm_t::reportDivergence(const dut_active_warp_t& warp, const char* kind, const insn_t* insn,
+  const std::string& detail) {
+  // 之后的错误多由第一个错误引起，只报告第一个
+  if (divergence_reported) {
+    return;
+  }
+  divergence_reported = true;
+  divergence_time = dut_events.time;
+  if (report_file.empty()) {
+    return;
+  }
+
+  std::string history;
+  const uint64_t num = std::min<uint64_t>(warp.history_count, warp.history.size());
+  for (uint64_t i = warp.history_count - num; i < warp.history_count; i++) {
+    const history_insn_t& h = warp.history[i % warp.history.size()];
+    history += fmt::format("{}\n  {{\"time\":{},\"insn\":{}}}", history.empty() ? "" : ",", h.time,
+      insn_to_json(h.insn, warp.num_thread));
+  }
+  std::string window;
+  for (const auto& w : warp.insns) {
+    window += fmt::format("{}\n  {}", window.empty() ? "" : ",", insn_to_json(w, warp.num_thread));
+  }
+
+  try {
+    auto out = fmt::output_file(report_file);
+    out.print(
+      "{{\"time\":{},\"kind\":\"{}\",\n\"warp\":{{\"sm_id\":{},\"hardware_warp_id\":{},\"software_wg_id\":{},"
+      "\"software_warp_id\":{},\"num_thread\":{},\"next_retire_dispatch_id\":{}}},\n\"insn\":{},\n\"detail\":{{{}}},\n"
+      "\"history\":[{}\n],\n\"window\":[{}\n]}}\n",
+      dut_events.time, kind, warp.sm_id, warp.hardware_warp_id, warp.software_wg_id, warp.software_warp_id,
+      warp.num_thread, warp.next_retire_dispatch_id, insn ? insn_to_json(*insn, warp.num_thread) : "null", detail,
+      history, window);
+  } catch (const std::exception& ex) {
+    logger->error("GVM: failed to write divergence report {}: {}", report_file, ex.what());
+    return;
+  }
+  logger->error("GVM: first divergence ({}) reported to {}", kind, report_file);
+}
+
+//
+// ------------------------- gvm_t::checkMem() ----------------------------------------------
+//
+
+uint64_t gvm_t::memHash(const void* data, uint64_t size) {
+  // 4 路独立的乘法-异或累加，每轮处理 32 字节，避免单条乘法依赖链成为瓶颈
+  constexpr uint64_t K0 = 0x9E3779B97F4A7C15ull, K1 = 0xFF51AFD7ED558CCDull, K2 = 0xC4CEB9FE1A85EC53ull;
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  uint64_t h[4] = { K0, K1, K2, K0 ^ size };
+  uint64_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    uint64_t w[4];
+    memcpy(w, p + i, 32);
+    for (int j = 0; j < 4; j++) {
+      h[j] = (h[j] ^ w[j]) * K1;
+      h[j] ^= h[j] >> 29;
+    }
+  }
+  for (; i < size; i += 8) {
+    uint64_t w = 0;
+    memcpy(&w, p + i, std::min<uint64_t>(8, size - i));
+    h[0] = (h[0] ^ w) * K1;
+    h[0] ^= h[0] >> 29;
+  }
+  uint64_t r = h[0] ^ (h[1] * K0) ^ (h[2] * K2) ^ (h[3] * K1);
+  r ^= r >> 33;
+  r *= K2;
+  r ^= r >> 33;
+  return r;
+}
+
+uint32_t gvm_t::checkMem(const std::vector<gvm_mem_page_t>& pages, uint64_t pagesize) {
+  if (gvmref_read_mem == nullptr) {
+    static bool warned = false;
+    if (!warned) {
+      logger->info("GVM: REF does not provide gvmref_read_mem(), device memory is not checked");
+      warned = true;
+    }
+    return 0;
+  }
+  std::vector<uint8_t> ref(pagesize);
+  uint32_t num_mismatch = 0;
+  for (const auto& page : pages) {
+    if (gvmref_read_mem(page.base, ref.data(), pagesize) != 0) {
+      logger->error("GVM error: cannot read REF memory page 0x{:08x}", page.base);
+      num_mismatch++;
+      continue;
+    }
+    if (memHash(ref.data(), pagesize) == page.hash) {
+      continue;
+    }
+    num_mismatch++;
+    if (page.data == nullptr) {
+      logger->error("GVM error: DUT and REF memory mismatch in page 0x{:08x} (hash only)", page.base);
+      continue;
+    }
+    // 合并相邻的不同字节，只打印前几段
+    constexpr uint32_t MAX_RANGES = 8;
+    std::string ranges;
+    uint32_t num_ranges = 0;
+    uint64_t num_bytes = 0;
+    for (uint64_t i = 0; i < pagesize;) {
+      if (page.data[i] == ref[i]) {
+        i++;
+        continue;
+      }
+      uint64_t end = i;
+      while (end < pagesize && page.data[end] != ref[end]) {
+        end++;
+      }
+      if (num_ranges++ < MAX_RANGES) {
+        uint32_t dut_word = 0, ref_word = 0;
+        memcpy(&dut_word, page.data + i, std::min<uint64_t>(4, end - i));
+        memcpy(&ref_word, ref.data() + i, std::min<uint64_t>(4, end - i));
+        ranges += fmt::format(" [0x{:08x}, 0x{:08x}) DUT 0x{:08x}.. REF 0x{:08x}..;", page.base + i, page.base + end,
+          dut_word, ref_word);
+      }
+      num_bytes += end - i;
+      i = end;
+    }
+    logger->error("GVM error: DUT and REF memory mismatch in page 0x{:08x}, {} bytes in {} ranges:{}{}", page.base,
+      num_bytes, num_ranges, ranges, num_ranges > MAX_RANGES ? " ..." : "");
+  }
+  logger->info("GVM: device memory check of {} written pages, {} mismatched", pages.size(), num_mismatch);
+  return num_mismatch;
+}
+
+//
+// ------------------------- gvm_sample_t ----------------------------------------------
+//
+
+bool gvm_sample_t::parse(const char* spec, std::string& err) {
+  std::string str(spec);
+  size_t begin = 0;
+  while (begin <= str.size()) {
+    size_t end = str.find(',', begin);
+    if (end == std::string::npos) {
+      end = str.size();
+    }
+    const std::string item = str.substr(begin, end - begin);
+    begin = end + 1;
+    if (item.empty()) {
+      continue;
+    }
+    const size_t eq = item.find('=');
+    const std::string key = item.substr(0, eq);
+    const std::string value = eq == std::string::npos ? "" : item.substr(eq + 1);
+    try {
+      size_t pos = 0;
+      if (key == "every") {
+        wg_interval = std::stoul(value, &pos);
+      } else if (key == "fraction") {
+        wg_fraction = std::stod(value, &pos);
+      } else if (key == "seed") {
+        seed = std::stoull(value, &pos);
+      } else if (key == "wg") {
+        wgs.insert(std::stoul(value, &pos));
+      } else if (key == "warp") { // WG.WARP
+        size_t dot = value.find('.');
+        if (dot == std::string::npos) {
+          throw std::invalid_argument("expect WG.WARP");
+        }
+        warps.insert({ std::stoul(value.substr(0, dot)), std::stoul(value.substr(dot + 1), &pos) });
+        pos += dot + 1;
+      } else if (key == "time") { // BEGIN-END，END 可省略
+        size_t dash = value.find('-');
+        time_begin = std::stoull(value.substr(0, dash), &pos);
+        if (dash != std::string::npos) {
+          pos = dash + 1;
+          if (pos < value.size()) {
+            size_t n;
+            time_end = std::stoull(value.substr(pos), &n);
+            pos += n;
+          }
+        }
+      } else {
+        throw std::invalid_argument("unknown key");
+      }
+      if (pos != value.size()) {
+        throw std::invalid_argument("trailing characters");
+      }
+    } catch (const std::exception& e) {
+      err = "invalid GVM sample rule \"" + item + "\": " + e.what();
+      return false;
+    }
+  }
+  return true;
+}
+
+bool gvm_sample_t::all() const {
+  return wg_interval <= 1 && wg_fraction >= 1.0 && wgs.empty() && warps.empty() && time_begin == 0
+    && time_end == UINT64_MAX;
+}
+
+bool gvm_sample_t::wgSampled(uint32_t software_wg_id, uint64_t time) const {
+  if (wg_interval > 1 && software_wg_id % wg_interval != 0) {
+    return false;
+  }
+  if (wg_fraction < 1.0) {
+    uint64_t h = seed + (software_wg_id + 1) * 0x9E3779B97F4A7C15ull; // splitmix64
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+    h ^= h >> 31;
+    if ((h >> 11) * 0x1.0p-53 >= wg_fraction) {
+      return false;
+    }
+  }
+  if (time < time_begin || time >= time_end) {
+    return false;
+  }
+  if (wgs.empty() && warps.empty()) {
+    return true;
+  }
+  auto it = warps.lower_bound({ software_wg_id, 0 });
+  return wgs.count(software_wg_id) || (it != warps.end() && it->first == software_wg_id);
+}
+
+bool gvm_sample_t::warpChecked(uint32_t software_wg_id, uint32_t software_warp_id) const {
+  return (wgs.empty() && warps.empty()) || wgs.count(software_wg_id)
+    || warps.count({ software_wg_id, software_warp_id });
+}
@@ -4,6 +4,7 @@
 
 #include <cstdint>
 #include <map>
+#include <string>
 #include <vector>
 #include <memory>
 #include <spdlog/logger.h>
@@ -18,25 +19,56 @@ public:
   gvm_t() = default;
   ~gvm_t() = default;
 
-  void getDut(); // 更新 DUT 成员变量，清空全局变量
+  void getDut(); // 根据 dut_events 更新 DUT 成员变量，然后清空 dut_events
   int gvmStep(); // 执行 GVM 步进行为
 
   std::shared_ptr<spdlog::logger> logger;
+  GvmDutEvents dut_events; // 待处理的一个周期的 DUT 事件，见 gvm_dut_events_take()
+  // 为 true 时寄存器堆从 dut_events.xregs 读取（异步比对与离线回放），否则经 DPI 按需读取
+  bool xreg_from_events = false;
+  gvm_sample_t sample; // 采样比对策略，须在第一个 warp 分派前设置
+  // kernel 结束时比对 DUT 写入过的页与 REF 内存，返回不一致的页数；REF 未提供 gvmref_read_mem() 时不比对
+  // 只访问 REF 与 logger，异步比对时可在比对线程空闲（drain 之后）由仿真线程调用
+  uint32_t checkMem(const std::vector<gvm_mem_page_t>& pages, uint64_t pagesize);
+  static uint64_t memHash(const void* data, uint64_t size); // 快速 64 位哈希，只用于判断两份内存是否相同
+  uint32_t history_depth = 16; // 每个 warp 保留最近多少条指令供出错报告使用，须在第一个 warp 分派前设置
+  std::string report_file; // 首次比对出错时写入的 JSON 报告，为空表示不写入
+  uint64_t divergence_time = UINT64_MAX; // 首次比对出错的 DUT 事件时刻，供快照回滚选择快照
 
 private:
   std::map<warp_key_t, dut_active_warp_t> dut_active_warps;
+  // [sm_id][hardware_warp_id] -> dut_active_warps 中的条目，空指针表示该硬件 warp 空闲
+  // 在 warp 创建与 endprg 时维护，用于按硬件 id 查找 warp
+  std::vector<std::vector<dut_active_warp_t*>> dut_warps_by_hw;
+  dut_active_warp_t* findDutWarpByHw(uint32_t sm_id, uint32_t hardware_warp_id);
+  void setDutWarpByHw(uint32_t sm_id, uint32_t hardware_warp_id, dut_active_warp_t* warp);
+
+  // 未采样的 warp：不建立 dut_active_warps 条目，其 DUT 事件在 getDutDropUnsampled() 中丢弃
+  static constexpr uint32_t NOT_UNSAMPLED = UINT32_MAX;
+  std::vector<std::vector<uint32_t>> unsampled_wg_by_hw; // [sm_id][hardware_warp_id] -> 未采样 warp 的 software_wg_id
+  struct unsampled_wg_t {
+    std::vector<uint32_t> warps; // 该 WG 中未采样的 software_warp_id
+    uint32_t num_running = 0; // 其中 DUT 尚未 endprg 的 warp 数
+  };
+  std::map<uint32_t, unsampled_wg_t> unsampled_wgs; // software_wg_id -> ...
+  static constexpr uint64_t UNSAMPLED_WG_MAX_STEPS = 1ull << 26; // advanceRefWg() 对每个 WG 最多步进的次数
+  uint32_t& unsampledWgByHw(uint32_t sm_id, uint32_t hardware_warp_id);
+  void advanceRefWg(uint32_t software_wg_id, const std::vector<uint32_t>& software_warp_ids);
 
   // getDut() 相关函数
+  void getDutDropUnsampled(); // 丢弃未采样 warp 的事件
   void getDutWarpNew(); // 添加新 warp 条目
   void getDutWarpFinish(); // 删除已完成 warp 条目
+  void finishRefWarp(dut_active_warp_t& warp); // endprg 时让 REF 执行完该 warp 尚未 retire 的指令
   void getDutInsnDispatch(); // 添加新指令条目
   void getDutInsnFinish();
   void getDutXRegWbFinish();
   void getDutVRegWbFinish();
   void getDutBarDone();
-  void getDutXReg(); // 根据 warp 条目更新 XReg 条目
+  void setInsnDone(dut_active_warp_t& warp, insn_t& insn); // 标记指令已完成，并维护该 warp 的乱序完成计数
+  void getDutXReg(dut_active_warp_t& warp); // 按需读取 DUT 寄存器堆，更新该 warp 的 curr_xreg
   void getDutWarpNewSetRefXReg();
-  void clearGlobal(); // 清空全局变量
+  void setRefXReg(dut_active_warp_t& warp); // 将 DUT 中该 warp 的标量寄存器同步到 REF
 
   // gvmStep() 相关函数
   void checkRetire();
@@ -48,13 +80,22 @@ private:
   int doRetireCmp();
   void clearInsnItem();
   void resetRetireInfo();
+  // 首次比对出错时输出报告：出错的指令与比对细节、该 warp 的最近指令与指令窗口。detail 为 JSON 对象的成员列表
+  bool divergence_reported = false;
+  void reportDivergence(const dut_active_warp_t& warp, const char* kind, const insn_t* insn, const std::string& detail);
+
+public:
+  // 指令分类，可按位组合；模式表与编译期生成的查找表见 gvm_care_insns.cpp
+  enum care_class_t : uint32_t {
+    CARE_RETIRE = 1 << 0, // 影响 retire 的指令（标量写回与 barrier）
+    CARE_SINGLE_INSN_CMP = 1 << 1, // 参与单指令比对的指令（向量写回）
+    CARE_FP32_VREG = 1 << 2, // 写回 fp32 向量的指令，比对时允许误差
+    CARE_BARRIER = 1 << 3,
+  };
+  static uint32_t classifyInsn(uint32_t insn);
+  static const char* disasm(uint32_t insn); // 未识别的指令返回 " "
 
+private:
   // 判断指令是否关心
-  bool isInsnCare(uint32_t insn, const std::vector<care_insn_t> care_insns);
-  static const std::vector<care_insn_t> retire_care_insns;
-  static const std::vector<care_insn_t> single_insn_cmp_care_insns;
-  static const std::vector<care_insn_t> fp32_vreg_insns;
-  void disasm(uint32_t insn, char* insn_name);
-  static const std::vector<care_insn_t> disasm_table;
-  static const std::vector<care_insn_t> barrier_insns;
+  static bool isInsnCare(uint32_t insn, uint32_t care_class) { return (classifyInsn(insn) & care_class) != 0; }
 };
\ No newline at end of file
@@ -66,7 +66,7 @@ VLIB_SRC_SCALA = $(shell find $(VLIB_DIR_SCALA) -name "*.scala")
 VLIB_SRC_V_DIR = verilog-out
 VLIB_SRC_V = $(VLIB_SRC_V_DIR)/dut.sv
 VLIB_SRC_CXX_EXPORT = ventus_rtlsim.cpp# API in these files will be exported to shared library
-VLIB_SRC_CXX = kernel.cpp physical_mem.cpp cta_sche_wrapper.cpp ventus_rtlsim_impl.cpp rtl_parameters.cpp gvm_care_insns.cpp gvm_dpic.cpp gvm.cpp gvm_global_var.cpp $(VLIB_SRC_CXX_EXPORT)
+VLIB_SRC_CXX = kernel.cpp physical_mem.cpp cta_sche_wrapper.cpp timeline.cpp ventus_rtlsim_impl.cpp rtl_parameters.cpp gvm_care_insns.cpp gvm_dpic.cpp gvm.cpp gvm_async.cpp gvm_trace.cpp gvm_global_var.cpp $(VLIB_SRC_CXX_EXPORT)
 VLIB_SRC_CXX_ABSPATH = $(abspath $(VLIB_SRC_CXX))
 VLIB_VERILATOR_INPUT = $(wildcard $(VLIB_SRC_V_DIR)/*.sv) $(VLIB_SRC_CXX_ABSPATH)
 VLIB_VERILATOR_OUTPUT = $(VLIB_DIR_BUILDOBJ)/libVdut.a
@@ -187,7 +187,21 @@ $(VLIB_TARGET): $(VLIB_VERILATOR_OUTPUT)
 
 lib: $(VLIB_TARGET)
 
-.PHONY: verilog verilate lib
+# Offline checker for traces recorded with config.gvm.record_file (--gvm-record), no verilated model needed
+GVM_REPLAY_SRC_CXX = gvm_replay.cpp gvm.cpp gvm_care_insns.cpp gvm_trace.cpp gvm_global_var.cpp
+GVM_REPLAY_TARGET = $(VLIB_DIR_BUILDOBJ)/gvm-replay
+VLIB_VERILATOR_ROOT = $(shell $(VLIB_VERILATOR) --getenv VERILATOR_ROOT)
+
+$(GVM_REPLAY_TARGET): $(GVM_REPLAY_SRC_CXX) $(wildcard *.hpp *.h)
+	@mkdir -p $(VLIB_DIR_BUILDOBJ)
+	$(CXX) $(VLIB_CXXFLAGS) -I$(VLIB_VERILATOR_ROOT)/include/vltstd -o $@ $(GVM_REPLAY_SRC_CXX) \
+	  -lspdlog -lfmt -pthread -lz \
+	  -lgvmref -L$(GVM_REF_DIR) -Wl,--enable-new-dtags -Wl,-rpath,$(abspath $(GVM_REF_DIR))
+	ln -sf $(abspath $(GVM_REPLAY_TARGET)) $(VLIB_DIR_BUILD)/gvm-replay
+
+gvm-replay: $(GVM_REPLAY_TARGET)
+
+.PHONY: verilog verilate lib gvm-replay
 
 #=====================================================================
 # Other targets
@@ -201,10 +215,12 @@ install: $(VLIB_TARGET)
 	install -m 644 $(VLIB_TARGET) $(PREFIX)/lib/
 	install -d $(PREFIX)/include
 	install -m 644 ventus_rtlsim.h $(PREFIX)/include/
+	if [ -f $(GVM_REPLAY_TARGET) ]; then install -d $(PREFIX)/bin && install -m 755 $(GVM_REPLAY_TARGET) $(PREFIX)/bin/; fi
 
 clean-lib:
 	-rm -f $(VLIB_DIR_BUILDOBJ_DEBUG)/*.a $(VLIB_DIR_BUILDOBJ_DEBUG)/*.o $(VLIB_DIR_BUILDOBJ_DEBUG)/*.so
 	-rm -f $(VLIB_DIR_BUILDOBJ_RELEASE)/*.a $(VLIB_DIR_BUILDOBJ_RELEASE)/*.o $(VLIB_DIR_BUILDOBJ_RELEASE)/*.so
+	-rm -f $(VLIB_DIR_BUILDOBJ_DEBUG)/gvm-replay $(VLIB_DIR_BUILDOBJ_RELEASE)/gvm-replay
 	-rm -f $(VLIB_DIR_BUILD)/*.so
 
 clean-lib-dep: clean-lib
@@ -0,0 +1,106 @@
+// GVM 异步比对的实现
+
+#include "gvm_async.hpp"
+#include "gvm_dpic.hpp"
+#include <cassert>
+#include <utility>
+
+gvm_async_t g_gvm_async;
+
+static thread_local uint64_t t_event_time = UINT64_MAX;
+
+uint64_t gvm_async_t::eventTime() {
+  return t_event_time;
+}
+
+gvm_async_t::~gvm_async_t() {
+  stop();
+}
+
+void gvm_async_t::start(gvm_t* gvm_, uint32_t queue_depth) {
+  assert(!running());
+  gvm = gvm_;
+  gvm->xreg_from_events = true;
+  ring.resize(queue_depth > 0 ? queue_depth : 1);
+  head.store(0);
+  tail.store(0);
+  stopping.store(false);
+  worker = new std::thread(&gvm_async_t::workerLoop, this);
+}
+
+void gvm_async_t::push(uint64_t time) {
+  assert(running());
+  const uint64_t h = head.load(std::memory_order_relaxed);
+  GvmDutEvents& ev = ring[h % ring.size()];
+  // 等待 ev 所在的槽位被比对线程处理完毕
+  for (uint64_t t = tail.load(std::memory_order_acquire); h - t >= ring.size();
+       t = tail.load(std::memory_order_acquire)) {
+    tail.wait(t, std::memory_order_acquire);
+  }
+  gvm_dut_events_take(ev, time);
+  if (ev.empty()) {
+    return; // 没有事件的周期不会改变 GVM 状态，无需入队
+  }
+
+  // 比对线程无法访问 DUT，需在这里预先读取可能用到的寄存器堆
+  gvm_dut_events_capture_xregs(ev);
+
+  head.store(h + 1, std::memory_order_release);
+  head.notify_one();
+}
+
+void gvm_async_t::drain() {
+  if (!running()) {
+    return;
+  }
+  const uint64_t h = head.load(std::memory_order_relaxed);
+  for (uint64_t t = tail.load(std::memory_order_acquire); t != h; t = tail.load(std::memory_order_acquire)) {
+    tail.wait(t, std::memory_order_acquire);
+  }
+}
+
+void gvm_async_t::stop() {
+  if (!running()) {
+    return;
+  }
+  drain();
+  // 多推进一个空位作为停止信号，比对线程看到 stopping 后不会处理它
+  stopping.store(true, std::memory_order_release);
+  head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  head.notify_one();
+  worker->join();
+  delete worker;
+  worker = nullptr;
+  gvm->xreg_from_events = false;
+}
+
+void gvm_async_t::restartAfterFork() {
+  if (!running()) {
+    return;
+  }
+  // fork 前已 drain，比对线程停在等待处，未持有任何锁；子进程中该线程不存在，其 std::thread 对象只能泄漏
+  assert(head.load() == tail.load());
+  worker = new std::thread(&gvm_async_t::workerLoop, this);
+}
+
+void gvm_async_t::workerLoop() {
+  while (true) {
+    const uint64_t t = tail.load(std::memory_order_relaxed);
+    const uint64_t h = head.load(std::memory_order_acquire);
+    if (h == t) {
+      head.wait(h, std::memory_order_acquire);
+      continue;
+    }
+    if (stopping.load(std::memory_order_acquire)) {
+      break;
+    }
+    GvmDutEvents& ev = ring[t % ring.size()];
+    t_event_time = ev.time;
+    std::swap(gvm->dut_events, ev);
+    gvm->getDut(); // 处理后清空 dut_events，交换回去后留下容量供复用
+    gvm->gvmStep();
+    std::swap(gvm->dut_events, ev);
+    tail.store(t + 1, std::memory_order_release);
+    tail.notify_one();
+  }
+}
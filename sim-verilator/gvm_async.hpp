@@ -0,0 +1,45 @@
+// GVM 异步比对
+// 仿真线程每周期将 DUT 事件打包推入单生产者单消费者（SPSC）环形队列，比对线程取出后执行 getDut() 与 gvmStep()，
+// 使 REF 步进与比对和 Verilator eval 并行。仿真线程仅在队列满时阻塞；致命错误仍由比对线程中的 assert 终止进程。
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "gvm.hpp"
+#include "gvm_global_var.hpp"
+
+class gvm_async_t
+{
+public:
+  gvm_async_t() = default;
+  ~gvm_async_t();
+
+  void start(gvm_t* gvm, uint32_t queue_depth); // 启动比对线程，此后 gvm 只能由比对线程访问
+  bool running() const { return worker != nullptr; }
+  // 仿真线程调用：取走本周期的 DUT 事件并入队，队列满时阻塞
+  void push(uint64_t time);
+  // 等待比对线程处理完所有已入队的周期，之后仿真线程可以安全地访问 gvm 与 REF
+  void drain();
+  void stop(); // drain 后结束比对线程
+  // fork 出的子进程中比对线程并不存在，需重新创建
+  void restartAfterFork();
+  // 在比对线程中返回正在处理的事件的仿真时间（入队时记录），供日志使用；其他线程返回 UINT64_MAX
+  static uint64_t eventTime();
+
+private:
+  void workerLoop();
+
+  gvm_t* gvm = nullptr;
+  std::thread* worker = nullptr;
+  std::vector<GvmDutEvents> ring;
+  alignas(64) std::atomic<uint64_t> head{ 0 }; // 已入队的周期数，仅仿真线程写
+  alignas(64) std::atomic<uint64_t> tail{ 0 }; // 已处理的周期数，仅比对线程写
+  std::atomic<bool> stopping{ false };
+};
+
+// fw_vt_* 等直接操作 REF 的接口须先调用 g_gvm_async.drain()
+extern gvm_async_t g_gvm_async;
@@ -1,6 +1,8 @@
 #include "gvm.hpp"
+#include <array>
+#include <cstddef>
 #include <cstdint>
-#include <vector>
+#include <iterator>
 
 #define XREG_INSNS \
   {0x0000007f, 0x00000037, "LUI"                 },\
@@ -81,24 +83,105 @@
   {0xfc00707f, 0xa0001057, "VFMADD_VV_            "},\
   {0xfc00707f, 0x18001057, "VFMAX_VV_             "},\
   {0xfc00707f, 0x00001057, "VFADD_VV_             "},\
-  
-  
 
-const std::vector<care_insn_t> gvm_t::retire_care_insns = {
-  XREG_INSNS
-  WARP_BARRIER_INSNS
-};
-const std::vector<care_insn_t> gvm_t::single_insn_cmp_care_insns = {
-  VREG_INSNS
-};
-const std::vector<care_insn_t> gvm_t::fp32_vreg_insns = {
-  FP32_VREG_INSNS
-};
-const std::vector<care_insn_t> gvm_t::disasm_table = {
-  XREG_INSNS
-  VREG_INSNS
-  WARP_BARRIER_INSNS
+// 以下查找表均在编译期生成
+// 按 opcode[6:0] 与 funct3[14:12] 将指令分桶，每条指令只需检查其所在桶中的少数模式
+
+namespace {
+
+struct decode_insn_t {
+  care_insn_t pattern;
+  uint32_t care_class; // gvm_t::care_class_t 的组合
+  bool in_disasm;
 };
-const std::vector<care_insn_t> gvm_t::barrier_insns = {
-  WARP_BARRIER_INSNS
+
+constexpr care_insn_t xreg_insns[] = { XREG_INSNS };
+constexpr care_insn_t vreg_insns[] = { VREG_INSNS };
+constexpr care_insn_t barrier_insns[] = { WARP_BARRIER_INSNS };
+constexpr care_insn_t fp32_vreg_insns[] = { FP32_VREG_INSNS };
+
+constexpr size_t NUM_DECODE_INSNS = std::size(xreg_insns) + std::size(vreg_insns) + std::size(barrier_insns)
+  + std::size(fp32_vreg_insns);
+
+constexpr std::array<decode_insn_t, NUM_DECODE_INSNS> decode_insns = [] {
+  std::array<decode_insn_t, NUM_DECODE_INSNS> table{};
+  size_t n = 0;
+  for (const auto& p : xreg_insns) table[n++] = { p, gvm_t::CARE_RETIRE, true };
+  for (const auto& p : vreg_insns) table[n++] = { p, gvm_t::CARE_SINGLE_INSN_CMP, true };
+  for (const auto& p : barrier_insns) table[n++] = { p, gvm_t::CARE_RETIRE | gvm_t::CARE_BARRIER, true };
+  for (const auto& p : fp32_vreg_insns) table[n++] = { p, gvm_t::CARE_FP32_VREG, false };
+  return table;
+}();
+
+constexpr uint32_t BUCKET_BITS_MASK = 0x0000707f; // funct3 | opcode
+constexpr uint32_t NUM_BUCKETS = 1 << 10;
+constexpr uint32_t bucket_of(uint32_t insn) { return (insn & 0x7f) | ((insn >> 5) & 0x380); }
+constexpr uint32_t bucket_bits(uint32_t bucket) { return (bucket & 0x7f) | ((bucket & 0x380) << 5); }
+constexpr bool in_bucket(const care_insn_t& p, uint32_t bucket) {
+  return ((bucket_bits(bucket) ^ p.value) & p.mask & BUCKET_BITS_MASK) == 0;
+}
+
+constexpr size_t NUM_BUCKET_ENTRIES = [] {
+  size_t n = 0;
+  for (uint32_t b = 0; b < NUM_BUCKETS; b++)
+    for (const auto& d : decode_insns)
+      n += in_bucket(d.pattern, b);
+  return n;
+}();
+
+struct decode_table_t {
+  std::array<uint16_t, NUM_BUCKETS + 1> bucket_begin; // 第 b 个桶为 entries[bucket_begin[b], bucket_begin[b + 1])
+  std::array<uint16_t, NUM_BUCKET_ENTRIES> entries; // 下标指向 decode_insns
 };
+
+constexpr decode_table_t decode_table = [] {
+  decode_table_t t{};
+  size_t n = 0;
+  for (uint32_t b = 0; b < NUM_BUCKETS; b++) {
+    t.bucket_begin[b] = n;
+    for (size_t i = 0; i < decode_insns.size(); i++)
+      if (in_bucket(decode_insns[i].pattern, b))
+        t.entries[n++] = i;
+  }
+  t.bucket_begin[NUM_BUCKETS] = n;
+  return t;
+}();
+static_assert(NUM_BUCKET_ENTRIES < UINT16_MAX && NUM_DECODE_INSNS < UINT16_MAX);
+
+// 反汇编表中任意两条模式不能匹配同一条指令
+constexpr bool disasm_unambiguous = [] {
+  for (size_t i = 0; i < decode_insns.size(); i++)
+    for (size_t j = i + 1; j < decode_insns.size(); j++) {
+      const auto& a = decode_insns[i];
+      const auto& b = decode_insns[j];
+      if (a.in_disasm && b.in_disasm && ((a.pattern.value ^ b.pattern.value) & a.pattern.mask & b.pattern.mask) == 0)
+        return false;
+    }
+  return true;
+}();
+static_assert(disasm_unambiguous, "multiple disasm patterns match the same instruction");
+
+} // namespace
+
+uint32_t gvm_t::classifyInsn(uint32_t insn) {
+  const uint32_t b = bucket_of(insn);
+  uint32_t care_class = 0;
+  for (uint32_t k = decode_table.bucket_begin[b]; k < decode_table.bucket_begin[b + 1]; k++) {
+    const decode_insn_t& d = decode_insns[decode_table.entries[k]];
+    if ((insn & d.pattern.mask) == d.pattern.value) {
+      care_class |= d.care_class;
+    }
+  }
+  return care_class;
+}
+
+const char* gvm_t::disasm(uint32_t insn) {
+  const uint32_t b = bucket_of(insn);
+  for (uint32_t k = decode_table.bucket_begin[b]; k < decode_table.bucket_begin[b + 1]; k++) {
+    const decode_insn_t& d = decode_insns[decode_table.entries[k]];
+    if (d.in_disasm && (insn & d.pattern.mask) == d.pattern.value) {
+      return d.pattern.name;
+    }
+  }
+  return " ";
+}
@@ -1,11 +1,14 @@
 // DPI-C 函数实现
 
 #include <vector>
+#include <cstddef>
 #include <cstdint>
 #include <array>
 #include "gvm_global_var.hpp"
 #include "gvm_dpic.hpp"
 #include <cassert>
+#include <svdpi.h>
+#include "Vdut__Dpi.h"
 
 extern "C" {
 
@@ -69,55 +72,47 @@ void c_GvmDutXRegWriteback(int sm_id,
 }
 
 // XRegs
-void c_GvmDutXReg(int num_sm,
-                   int sm_id,
-                   int num_bank,
-                   int num_sgpr_slots,
-                   int xbanks_word,
-                   int xbanks_word_idx) {
-  // if std::vector<XRegData> g_xreg_data;为空
-  // 初始化std::vector<XRegData> g_xreg_data，XRegData的个数为num_bank，g_xreg_data(i).bank_data里的word个数为num_sgpr_slots/num_bank
-  // 根据xbanks_word_idx的值，给g_xreg_data(i).bank_data(j)赋值
-  // i = xbanks_word_idx/(num_sgpr_slots/num_bank)
-  // j = xbanks_word_idx%(num_sgpr_slots/num_bank)
-    if (g_xreg_data.empty()) {
-      g_xreg_data.resize(num_sm * num_bank);
-      for (int i = 0; i < num_sm * num_bank; i++) {
-        g_xreg_data[i].bank_data.resize(num_sgpr_slots / num_bank);
-      }
-    }
-
-    g_xreg_data[sm_id*num_bank + xbanks_word_idx/(num_sgpr_slots/num_bank)].sm_id = sm_id;
-    g_xreg_data[sm_id*num_bank + xbanks_word_idx/(num_sgpr_slots/num_bank)].bank_id
-      = xbanks_word_idx/(num_sgpr_slots/num_bank);
-    g_xreg_data[sm_id*num_bank + xbanks_word_idx/(num_sgpr_slots/num_bank)].num_bank = num_bank;
-    g_xreg_data[sm_id*num_bank + xbanks_word_idx/(num_sgpr_slots/num_bank)].num_sgpr_slots
-      = num_sgpr_slots;
-    g_xreg_data[sm_id*num_bank + xbanks_word_idx/(num_sgpr_slots/num_bank)]
-      .bank_data[xbanks_word_idx%(num_sgpr_slots/num_bank)] = xbanks_word;
-
+void c_GvmDutXRegRegister(int num_sm,
+                           int sm_id,
+                           int num_bank,
+                           int num_sgpr_slots) {
+  if (g_xreg_data.empty()) {
+    g_xreg_data.resize(num_sm);
   }
+  assert(sm_id >= 0 && static_cast<size_t>(sm_id) < g_xreg_data.size());
+  assert(num_bank > 0 && num_sgpr_slots % num_bank == 0);
+  XRegData& d = g_xreg_data[sm_id];
+  d.scope = svGetScope();
+  d.num_bank = num_bank;
+  d.num_sgpr_slots = num_sgpr_slots;
+  d.captured = false;
+  d.xbanks.resize(num_sgpr_slots);
+}
 
 // VReg Writeback
 void c_GvmDutVRegWriteback(int sm_id,
-                            int rd_data,    
+                            const svBitVecVal* rd_data,
                             bool is_vector_wb,
                             int reg_idx,
                             int hardware_warp_id,
                             int pc,
                             int inst,
                             int dispatch_id,
-                            bool wvd_mask,   
-                            int thread_idx) { 
-  g_vreg_wb_data[{sm_id, hardware_warp_id, dispatch_id}].sm_id = sm_id;
-  g_vreg_wb_data[{sm_id, hardware_warp_id, dispatch_id}].rd_data[thread_idx] = rd_data;
-  g_vreg_wb_data[{sm_id, hardware_warp_id, dispatch_id}].is_vector_wb = is_vector_wb;
-  g_vreg_wb_data[{sm_id, hardware_warp_id, dispatch_id}].reg_idx = reg_idx;
-  g_vreg_wb_data[{sm_id, hardware_warp_id, dispatch_id}].hardware_warp_id = hardware_warp_id;
-  g_vreg_wb_data[{sm_id, hardware_warp_id, dispatch_id}].pc = pc;
-  g_vreg_wb_data[{sm_id, hardware_warp_id, dispatch_id}].insn = inst;
-  g_vreg_wb_data[{sm_id, hardware_warp_id, dispatch_id}].dispatch_id = dispatch_id;
-  g_vreg_wb_data[{sm_id, hardware_warp_id, dispatch_id}].wvd_mask[thread_idx] = wvd_mask;
+                            const svBitVecVal* wvd_mask,
+                            int num_thread) {
+  VRegWritebackData& d = g_vreg_wb_data.emplace_back();
+  assert(num_thread >= 0 && static_cast<size_t>(num_thread) <= d.rd_data.size());
+  d.sm_id             = sm_id;
+  d.is_vector_wb      = is_vector_wb;
+  d.reg_idx           = reg_idx;
+  d.hardware_warp_id  = hardware_warp_id;
+  d.pc                = pc;
+  d.insn              = inst;
+  d.dispatch_id       = dispatch_id;
+  for (int i = 0; i < num_thread; i++) {
+    d.rd_data[i] = rd_data[i];
+    d.wvd_mask[i] = (wvd_mask[i / 32] >> (i % 32)) & 1;
+  }
 }
 
 // Barrier done
@@ -135,4 +130,60 @@ void c_GvmDutBarrierDone(int sm_id,
   g_bar_done_data.push_back(d);
 }
 
-} // extern "C"
\ No newline at end of file
+} // extern "C"
+
+const XRegData& gvm_dut_xreg_capture(uint32_t sm_id) {
+  assert(sm_id < g_xreg_data.size() && g_xreg_data[sm_id].scope != nullptr);
+  XRegData& d = g_xreg_data[sm_id];
+  if (!d.captured) {
+    svSetScope(d.scope);
+    GvmDutXRegRead(reinterpret_cast<svBitVecVal*>(d.xbanks.data()));
+    d.captured = true;
+  }
+  return d;
+}
+
+void gvm_dut_xreg_invalidate() {
+  for (auto& d : g_xreg_data) {
+    d.captured = false;
+  }
+}
+
+void gvm_dut_events_take(GvmDutEvents& ev, uint64_t time) {
+  assert(ev.empty());
+  ev.time = time;
+  ev.cta2warp.swap(g_cta2warp_data);
+  ev.insn_dispatch.swap(g_insn_dispatch_data);
+  ev.xreg_wb.swap(g_xreg_wb_data);
+  ev.vreg_wb.swap(g_vreg_wb_data);
+  ev.bar_done.swap(g_bar_done_data);
+}
+
+void gvm_dut_events_capture_xregs(GvmDutEvents& ev) {
+  gvm_dut_xreg_invalidate();
+  ev.xregs.resize(g_xreg_data.size());
+  for (auto& x : ev.xregs) {
+    x.captured = false;
+  }
+  auto capture = [&ev](uint32_t sm_id) {
+    if (sm_id >= ev.xregs.size() || ev.xregs[sm_id].captured) {
+      return;
+    }
+    const XRegData& src = gvm_dut_xreg_capture(sm_id);
+    XRegData& dst = ev.xregs[sm_id];
+    dst.scope = nullptr;
+    dst.num_bank = src.num_bank;
+    dst.num_sgpr_slots = src.num_sgpr_slots;
+    dst.xbanks = src.xbanks;
+    dst.captured = true;
+  };
+  for (const auto& item : ev.cta2warp) {
+    capture(item.sm_id);
+  }
+  for (const auto& item : ev.xreg_wb) {
+    capture(item.sm_id);
+  }
+  for (const auto& item : ev.bar_done) {
+    capture(item.sm_id);
+  }
+}
@@ -4,6 +4,7 @@
 
 #include <vector>
 #include <cstdint>
+#include <svdpi.h>
 #include "gvm_global_var.hpp"
 
 extern "C" {
@@ -33,27 +34,35 @@ void c_GvmDutXRegWriteback(int sm_id,
                             int inst,
                             int dispatch_id);
 // XRegs
-void c_GvmDutXReg(int num_sm,
-                   int sm_id,
-                   int num_bank,
-                   int num_sgpr_slots,
-                   int xbanks_word,
-                   int xbanks_word_idx);
+void c_GvmDutXRegRegister(int num_sm,
+                           int sm_id,
+                           int num_bank,
+                           int num_sgpr_slots);
 // VReg Writeback  
 void c_GvmDutVRegWriteback(int sm_id,
-                            int rd_data,     // 单个线程的向量数据
+                            const svBitVecVal* rd_data,  // 所有线程的向量数据，线程 i 位于第 i 个字
                             bool is_vector_wb,
                             int reg_idx,
                             int hardware_warp_id,
                             int pc,
                             int inst,
                             int dispatch_id,
-                            bool wvd_mask,   // 单个线程的写回掩码
-                            int thread_idx); // 线程索引
+                            const svBitVecVal* wvd_mask, // 所有线程的写回掩码，线程 i 位于第 i 位
+                            int num_thread);
 // Barrier done
 void c_GvmDutBarrierDone(int sm_id,
                           int hardware_warp_id,
                           int pc,
                           int inst,
                           int dispatch_id);
-} // extern "C"
\ No newline at end of file
+} // extern "C"
+
+// 读取 sm_id 的整个标量寄存器堆，同一周期内重复调用不会重复读取
+const XRegData& gvm_dut_xreg_capture(uint32_t sm_id);
+// 新的周期开始，令已读取的寄存器堆失效
+void gvm_dut_xreg_invalidate();
+// 取走本周期 DPI-C 写入全局变量的全部事件（swap，ev 中原有的 vector 须为空，交还全局变量复用其容量）
+void gvm_dut_events_take(GvmDutEvents& ev, uint64_t time);
+// 为 gvm_t 不能经 DPI 读取 DUT 的场合（异步比对、录制）预先读取本周期可能用到的寄存器堆，写入 ev.xregs
+// 新 warp 分派（同步 REF 寄存器）与 retire 比对都只发生在该 SM 有 cta2warp、标量写回或 barrier 完成的周期
+void gvm_dut_events_capture_xregs(GvmDutEvents& ev);
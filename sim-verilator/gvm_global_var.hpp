@@ -45,14 +45,16 @@ struct XRegWritebackData {
   uint32_t dispatch_id;
 };
 extern std::vector<XRegWritebackData> g_xreg_wb_data;
+// XRegs
+// 标量寄存器堆不再每周期传入，GVM 需要时调用 gvm_dut_xreg_capture() 按 SM 一次性读取
 struct XRegData {
-  uint32_t sm_id;
-  uint32_t bank_id;
+  void* scope; // 该 SM 上 GvmDutXReg 实例的 svScope，为空表示尚未登记
   uint32_t num_bank;
   uint32_t num_sgpr_slots;
-  std::vector<uint32_t> bank_data;
+  bool captured; // 本周期是否已读取
+  std::vector<uint32_t> xbanks; // 第 i 个 bank 的第 j 个字位于 xbanks[i * (num_sgpr_slots / num_bank) + j]
 };
-extern std::vector<XRegData> g_xreg_data;
+extern std::vector<XRegData> g_xreg_data; // 以 sm_id 为下标
 extern uint32_t g_sgprUsage; // num of sgpr used in one warp
 
 // VReg Writeback
@@ -67,7 +69,7 @@ struct VRegWritebackData {
   uint32_t dispatch_id;
   std::array<bool, 32> wvd_mask; // 向量写回掩码，32个线程
 };
-extern std::map<std::tuple<uint32_t,uint32_t,uint32_t>, VRegWritebackData> g_vreg_wb_data;
+extern std::vector<VRegWritebackData> g_vreg_wb_data; // 本周期的向量写回，按到达顺序
 
 // Barrier
 struct BarDoneData {
@@ -77,4 +79,28 @@ struct BarDoneData {
   uint32_t insn;
   uint32_t dispatch_id;
 };
-extern std::vector<BarDoneData> g_bar_done_data;
\ No newline at end of file
+extern std::vector<BarDoneData> g_bar_done_data;
+
+// 一个周期内 DUT 经 DPI-C 产生的全部事件，由 gvm_dut_events_take() 从上述全局变量中整体取走
+// gvm_t 只读取这里的数据，因此也可以在另一个线程中处理（见 gvm_async.hpp）
+struct GvmDutEvents {
+  uint64_t time;
+  std::vector<Cta2WarpData> cta2warp;
+  std::vector<InsnDispatchData> insn_dispatch;
+  std::vector<XRegWritebackData> xreg_wb;
+  std::vector<VRegWritebackData> vreg_wb;
+  std::vector<BarDoneData> bar_done;
+  // 仅异步、录制与回放模式使用：预先读取的寄存器堆，以 sm_id 为下标，未读取的 SM 其 captured 为 false
+  std::vector<XRegData> xregs;
+
+  bool empty() const {
+    return cta2warp.empty() && insn_dispatch.empty() && xreg_wb.empty() && vreg_wb.empty() && bar_done.empty();
+  }
+  void clear() {
+    cta2warp.clear();
+    insn_dispatch.clear();
+    xreg_wb.clear();
+    vreg_wb.clear();
+    bar_done.clear();
+  }
+};
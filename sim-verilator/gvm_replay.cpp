@@ -0,0 +1,316 @@
+// gvm-replay：离线回放 GVM 录制轨迹（见 gvm_trace.hpp），驱动 REF 并执行与在线模式相同的比对
+//
+// 用法：gvm-replay [-j JOBS] [--sample RULES] [--report FILE] [--log-level LEVEL] TRACE
+//   --sample RULES  采样比对，规则格式同 ventus_rtlsim_config_t::gvm.sample
+//   --report FILE   首次比对出错时写入 JSON 报告，格式同 ventus_rtlsim_config_t::gvm.report_file；-j 时各进程写入 FILE.<进程号>
+//   -j JOBS  按 workgroup 拆分为 JOBS 个进程并行比对，进程 i 只比对 software_wg_id % JOBS == i 的 warp。
+//            gvm_t 以 warp_key_t 区分 warp，不同 WG 的比对互不影响；但 REF 的内存由所有 WG 共享，
+//            后一个 kernel 可能读取前一个 kernel 中其他进程负责的 WG 的结果，因此轨迹中有多个 kernel 时退回单进程；
+//            同理，kernel 结束时的内存比对只在单进程回放时进行
+// 返回值：0 表示没有发现错误
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+#include <spdlog/logger.h>
+#include <spdlog/sinks/base_sink.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+#include "gvmref_interface.h"
+#include "gvm_dpic.hpp"
+#include "gvm.hpp"
+#include "gvm_trace.hpp"
+
+// 回放时寄存器堆全部来自轨迹（gvm_t::xreg_from_events），不会经 DPI 读取 DUT
+const XRegData& gvm_dut_xreg_capture(uint32_t sm_id) {
+  fprintf(stderr, "gvm-replay: unexpected DUT xreg access (sm_id %u)\n", sm_id);
+  abort();
+}
+void gvm_dut_xreg_invalidate() {}
+
+// 统计 error 及以上级别的日志条数，作为回放结果
+class error_count_sink_t : public spdlog::sinks::base_sink<std::mutex>
+{
+public:
+  uint64_t count = 0;
+
+protected:
+  void sink_it_(const spdlog::details::log_msg& msg) override { count += msg.level >= spdlog::level::err; }
+  void flush_() override {}
+};
+
+struct replay_part_t {
+  uint32_t part;      // 本进程负责 software_wg_id % num_parts == part 的 WG
+  uint32_t num_parts;
+  // 由 cta2warp 建立的硬件位置到 software_wg_id 的映射，硬件 warp 被重新分派时覆盖
+  std::map<std::pair<uint32_t, uint32_t>, uint32_t> wg_of_hw_warp; // (sm_id, hardware_warp_id)
+  std::map<std::pair<uint32_t, uint32_t>, uint32_t> wg_of_slot;    // (sm_id, wg_slot_id_in_warp_sche)
+
+  bool mine(const std::map<std::pair<uint32_t, uint32_t>, uint32_t>& m, uint32_t sm_id, uint32_t id) const {
+    auto it = m.find({ sm_id, id });
+    return (it == m.end() ? 0 : it->second % num_parts) == part; // 无法归属的事件由进程 0 处理
+  }
+  // 只保留本进程负责的 WG 的事件
+  void filter(GvmDutEvents& ev) {
+    if (num_parts == 1) {
+      return;
+    }
+    for (const auto& item : ev.cta2warp) {
+      wg_of_hw_warp[{ item.sm_id, item.hardware_warp_id }] = item.software_wg_id;
+      wg_of_slot[{ item.sm_id, item.wg_slot_id_in_warp_sche }] = item.software_wg_id;
+    }
+    std::erase_if(ev.cta2warp, [this](const auto& d) { return d.software_wg_id % num_parts != part; });
+    auto other_warp = [this](const auto& d) { return !mine(wg_of_hw_warp, d.sm_id, d.hardware_warp_id); };
+    std::erase_if(ev.insn_dispatch, other_warp);
+    std::erase_if(ev.xreg_wb, other_warp);
+    std::erase_if(ev.vreg_wb, other_warp);
+    std::erase_if(ev.bar_done, [this](const auto& d) { return !mine(wg_of_slot, d.sm_id, d.wg_slot_id); });
+  }
+};
+
+// 按录制顺序重放驱动对 REF 的调用，返回值或分配地址与录制时不同则报错
+static void replay_host_call(const gvm_trace_host_call_t& call, const std::filesystem::path& tmpdir,
+  spdlog::logger& logger) {
+  const uint64_t* a = call.header.args;
+  int ret = 0;
+  switch (call.type) {
+  case GVM_TRACE_HOST_DEV_OPEN:
+    ret = gvmref_vt_dev_open();
+    break;
+  case GVM_TRACE_HOST_DEV_CLOSE:
+    ret = gvmref_vt_dev_close();
+    break;
+  case GVM_TRACE_HOST_BUF_ALLOC: {
+    uint64_t vaddr = 0;
+    ret = gvmref_vt_buf_alloc(a[0], &vaddr, static_cast<int>(a[2]), a[3], a[4]);
+    if (vaddr != a[1]) {
+      logger.error("gvm-replay: buf_alloc of size 0x{:x} returned vaddr 0x{:x}, recorded 0x{:x}", a[0], vaddr, a[1]);
+    }
+    break;
+  }
+  case GVM_TRACE_HOST_BUF_FREE: {
+    uint64_t vaddr = a[1];
+    ret = gvmref_vt_buf_free(a[0], &vaddr, a[2], a[3]);
+    break;
+  }
+  case GVM_TRACE_HOST_ONE_BUF_FREE: {
+    uint64_t vaddr = a[1];
+    ret = gvmref_vt_one_buf_free(a[0], &vaddr, a[2], a[3]);
+    break;
+  }
+  case GVM_TRACE_HOST_COPY_TO_DEV:
+    ret = gvmref_vt_copy_to_dev(a[0], call.data.data(), a[1], a[2], a[3]);
+    break;
+  case GVM_TRACE_HOST_START: {
+    std::vector<uint64_t> meta((call.data.size() + 7) / 8); // 保证 gvmref_meta_data 的对齐
+    memcpy(meta.data(), call.data.data(), call.data.size());
+    ret = gvmref_vt_start(meta.data(), a[0]);
+    break;
+  }
+  case GVM_TRACE_HOST_UPLOAD_KERNEL_FILE: {
+    const char* name = reinterpret_cast<const char*>(call.data.data());
+    const size_t name_len = strnlen(name, call.data.size());
+    if (name_len == call.data.size()) {
+      logger.error("gvm-replay: malformed upload_kernel_file record");
+      return;
+    }
+    const std::filesystem::path path = tmpdir / std::filesystem::path(name).filename();
+    std::ofstream(path, std::ios::binary)
+      .write(name + name_len + 1, call.data.size() - name_len - 1);
+    logger.debug("gvm-replay: kernel file {} restored to {}", name, path.string());
+    ret = gvmref_vt_upload_kernel_file(path.c_str(), static_cast<int>(a[0]));
+    break;
+  }
+  default:
+    assert(0);
+  }
+  if (ret != call.header.ret) {
+    logger.error("gvm-replay: REF host call (record type {}) returned {}, recorded {}",
+      static_cast<int>(call.type), ret, call.header.ret);
+  }
+}
+
+static int replay(const char* trace_file, uint32_t part, uint32_t num_parts, const gvm_sample_t& sample,
+  const char* report_file, spdlog::level::level_enum level) {
+  auto errors = std::make_shared<error_count_sink_t>();
+  auto console = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+  console->set_level(level);
+  std::vector<spdlog::sink_ptr> sinks{ console, errors };
+  auto logger = std::make_shared<spdlog::logger>("gvm-replay", sinks.begin(), sinks.end());
+  logger->set_level(std::min(level, spdlog::level::err));
+  logger->flush_on(spdlog::level::err);
+  if (num_parts > 1) {
+    logger->set_pattern(fmt::format("[%^%l%$] [part {}/{}] %v", part, num_parts));
+  } else {
+    logger->set_pattern("[%^%l%$] %v");
+  }
+
+  gvm_trace_reader_t reader;
+  if (!reader.open(trace_file)) {
+    logger->error("gvm-replay: {}", reader.error());
+    return EXIT_FAILURE;
+  }
+  char tmpdir_template[] = "/tmp/gvm-replay-XXXXXX";
+  if (mkdtemp(tmpdir_template) == nullptr) {
+    logger->error("gvm-replay: cannot create temporary directory: {}", strerror(errno));
+    return EXIT_FAILURE;
+  }
+  const std::filesystem::path tmpdir(tmpdir_template);
+
+  gvm_t gvm;
+  gvm.logger = logger;
+  gvm.xreg_from_events = true;
+  gvm.sample = sample;
+  if (report_file != nullptr) {
+    gvm.report_file = num_parts > 1 ? fmt::format("{}.{}", report_file, part) : report_file;
+  }
+  replay_part_t filter{ part, num_parts, {}, {} };
+  gvm_trace_host_call_t call;
+  uint64_t num_cycles = 0, num_host_calls = 0, time = 0;
+  for (gvm_trace_record_t type; (type = reader.next(gvm.dut_events, call)) != GVM_TRACE_EOF;) {
+    if (type == GVM_TRACE_MEM_CHECK) {
+      if (num_parts == 1) {
+        std::vector<gvm_mem_page_t> pages(call.header.args[1]);
+        for (size_t i = 0; i < pages.size(); i++) {
+          uint64_t page[2]; // base, hash
+          memcpy(page, call.data.data() + i * sizeof(page), sizeof(page));
+          pages[i] = { page[0], page[1], nullptr };
+        }
+        gvm.checkMem(pages, call.header.args[0]);
+      }
+      continue;
+    }
+    if (type != GVM_TRACE_CYCLE) {
+      replay_host_call(call, tmpdir, *logger);
+      num_host_calls++;
+      continue;
+    }
+    time = gvm.dut_events.time;
+    filter.filter(gvm.dut_events);
+    if (gvm.dut_events.empty()) {
+      gvm.dut_events.clear(); // 与异步模式相同，没有事件的周期不改变 GVM 状态
+      continue;
+    }
+    gvm.getDut();
+    gvm.gvmStep();
+    num_cycles++;
+  }
+  if (!reader.error().empty()) {
+    logger->error("gvm-replay: {} after time {}", reader.error(), time);
+  }
+  std::filesystem::remove_all(tmpdir);
+
+  logger->info("gvm-replay: {} cycles and {} host calls replayed up to time {}, {} errors",
+    num_cycles, num_host_calls, time, errors->count);
+  return errors->count == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// 统计轨迹中启动的 kernel 数
+static uint64_t count_kernel_starts(const char* trace_file) {
+  gvm_trace_reader_t reader;
+  if (!reader.open(trace_file)) {
+    return 0;
+  }
+  GvmDutEvents ev;
+  gvm_trace_host_call_t call;
+  uint64_t n = 0;
+  for (gvm_trace_record_t type; (type = reader.next(ev, call)) != GVM_TRACE_EOF;) {
+    n += type == GVM_TRACE_HOST_START;
+    ev.clear();
+  }
+  return n;
+}
+
+static int usage(const char* argv0) {
+  fprintf(stderr,
+    "usage: %s [-j JOBS] [--sample RULES] [--report FILE] [--log-level LEVEL] TRACE\n"
+    "  -j JOBS              split checking by workgroup into JOBS processes (single-kernel traces only)\n"
+    "  --sample RULES       check only sampled workgroups, e.g. every=4,fraction=0.5,seed=7,wg=3,warp=5.1,time=0-9000\n"
+    "  --report FILE        write a JSON report of the first mismatch with recent per-warp history\n"
+    "  --log-level LEVEL    trace | debug | info (default) | warn | error\n",
+    argv0);
+  return EXIT_FAILURE;
+}
+
+int main(int argc, char* argv[]) {
+  uint32_t jobs = 1;
+  spdlog::level::level_enum level = spdlog::level::info;
+  gvm_sample_t sample;
+  const char* report_file = nullptr;
+  const char* trace_file = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      jobs = std::max(1, atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--sample") == 0 && i + 1 < argc) {
+      std::string err;
+      if (!sample.parse(argv[++i], err)) {
+        fprintf(stderr, "gvm-replay: %s\n", err.c_str());
+        return EXIT_FAILURE;
+      }
+    } else if (strcmp(argv[i], "--report") == 0 && i + 1 < argc) {
+      report_file = argv[++i];
+    } else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
+      level = spdlog::level::from_str(argv[++i]);
+    } else if (argv[i][0] != '-' && trace_file == nullptr) {
+      trace_file = argv[i];
+    } else {
+      return usage(argv[0]);
+    }
+  }
+  if (trace_file == nullptr) {
+    return usage(argv[0]);
+  }
+
+  if (jobs > 1) {
+    const uint64_t num_kernels = count_kernel_starts(trace_file);
+    if (num_kernels > 1) {
+      fprintf(stderr, "gvm-replay: trace contains %llu kernels, falling back to -j 1\n",
+        static_cast<unsigned long long>(num_kernels));
+      jobs = 1;
+    }
+  }
+  if (jobs == 1) {
+    return replay(trace_file, 0, 1, sample, report_file, level);
+  }
+
+  // REF 为进程内单例，每个进程各自从头回放所有 REF 调用
+  fflush(stdout);
+  std::vector<pid_t> children;
+  for (uint32_t part = 0; part < jobs; part++) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      const int ret = replay(trace_file, part, jobs, sample, report_file, level);
+      fflush(stdout);
+      _exit(ret);
+    } else if (pid < 0) {
+      perror("gvm-replay: fork");
+      break;
+    }
+    children.push_back(pid);
+  }
+  int result = children.size() == jobs ? EXIT_SUCCESS : EXIT_FAILURE;
+  for (size_t part = 0; part < children.size(); part++) {
+    int status;
+    waitpid(children[part], &status, 0);
+    if (WIFSIGNALED(status)) {
+      fprintf(stderr, "gvm-replay: part %zu/%u killed by signal %d\n", part, jobs, WTERMSIG(status));
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+      result = EXIT_FAILURE;
+    }
+  }
+  return result;
+}
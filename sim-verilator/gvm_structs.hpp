@@ -3,7 +3,10 @@
 #pragma once
 
 #include <cstdint>
+#include <deque>
 #include <map>
+#include <set>
+#include <string>
 #include <vector>
 #include <memory>
 #include <spdlog/logger.h>
@@ -61,6 +64,11 @@ struct insn_t {
   uint32_t dispatch_id; // 需要注意该 id 在 SM 完成旧 warp 获得新 warp 时不会重置
 };
 
+struct history_insn_t {
+  uint64_t time; // 离开指令窗口（已 retire 且比对完成）时的仿真时间
+  insn_t insn;
+};
+
 struct dut_active_warp_t {
   uint32_t sm_id;
   uint32_t hardware_warp_id;
@@ -70,11 +78,43 @@ struct dut_active_warp_t {
   uint32_t xreg_usage;
   uint32_t wg_slot_id_in_warp_sche;
   std::vector<uint32_t> curr_xreg; // xreg
-  std::map<uint32_t, insn_t> insns; // dispatch_id -> insn
+  // 指令窗口：同一 warp 的 dispatch_id 连续，insns[i] 为 dispatch_id == insns_base + i 的指令
+  // 新指令从队尾加入，retire 且比对完成后从队首删除
+  std::deque<insn_t> insns;
+  uint32_t insns_base; // insns 队首指令的 dispatch_id
   uint32_t base_dispatch_id; // 本 warp 的首条指令的 dispatch_id
   uint32_t next_retire_dispatch_id; // 下一条应当被 retire 的指令的 id
   bool base_dispatch_id_set; // 是否设置了 base_dispatch_id，初始为 0
+  // 增量 retire 扫描的状态，见 gvm_t::checkRetire()
+  uint32_t retire_scan_dispatch_id; // [next_retire_dispatch_id, 该值) 中关心的指令均已完成，该值处的指令未完成或尚未 dispatch
+  uint32_t retire_ready_dispatch_id; // 上述区间中最后一条已完成的关心指令之后，retire 至此为止
+  uint32_t num_done_beyond_scan; // dispatch_id >= retire_scan_dispatch_id 的已完成的关心指令数，即乱序完成的指令
+  bool retire_scan_barriered; // 扫描停在一条已完成的 barrier 之后，待其 retire 后才继续
   uint32_t num_thread;
+  bool checked; // 是否比对该 warp 的结果；为 false 时仍跟踪 retire 并步进 REF，以便同一 WG 中被采样的 warp 通过 barrier
+  // 最近离开指令窗口的指令，定长环形缓冲区（容量见 gvm_t::history_depth），比对出错时写入报告
+  std::vector<history_insn_t> history;
+  uint64_t history_count; // 累计写入的条数，下一条写入 history[history_count % history.size()]
+
+  void pushHistory(uint64_t time, const insn_t& insn) {
+    if (!history.empty()) {
+      history[history_count++ % history.size()] = { time, insn };
+    }
+  }
+
+  insn_t* findInsn(uint32_t dispatch_id) {
+    uint32_t i = dispatch_id - insns_base; // dispatch_id 回绕时仍然正确
+    return i < insns.size() ? &insns[i] : nullptr;
+  }
+  // dispatch_id 在窗口中相对 insns_base 的位置，用于比较先后
+  uint32_t insnIndex(uint32_t dispatch_id) const { return dispatch_id - insns_base; }
+};
+
+// kernel 结束时待比对的一页 DUT 内存
+struct gvm_mem_page_t {
+  uint64_t base;
+  uint64_t hash; // gvm_t::memHash()
+  const uint8_t* data; // 页内容；离线回放时为空，只能比较哈希
 };
 
 using warp_key_t = std::pair<uint32_t, uint32_t>; // software_wg_id, software_warp_id
@@ -90,4 +130,24 @@ struct retireInfo_t {
     bool barrier_retry;
   };
   std::vector<retire_cnt_item_t> warp_retire_cnt;
-};
\ No newline at end of file
+};
+
+// 采样比对：按 WG 采样，未被采样的 WG 不建立 dut_active_warps 条目，其 DUT 事件在逐指令处理之前即被丢弃，
+// 但分派时仍同步其初始寄存器到 REF，REF 在 DUT 中全部 warp 结束后一次性步进到底（见 gvm_t::advanceRefWg）；被采样的 WG 中只比对 warpChecked() 的 warp
+// 默认全部比对
+struct gvm_sample_t {
+  uint32_t wg_interval = 0; // 只采样 software_wg_id % wg_interval == 0 的 WG，0 表示不限
+  double wg_fraction = 1.0; // 以 seed 为种子随机采样该比例的 WG（同一 seed 下结果固定）
+  uint64_t seed = 0;
+  std::set<uint32_t> wgs; // 采样这些 WG 并比对其全部 warp
+  std::set<warp_key_t> warps; // 采样这些 warp 所在的 WG，但只比对这些 warp；wgs 与 warps 都为空表示不限
+  uint64_t time_begin = 0; // 只采样第一个 warp 在 [time_begin, time_end) 内被分派的 WG
+  uint64_t time_end = UINT64_MAX;
+
+  // 解析逗号分隔的规则，例如 "every=4,fraction=0.5,seed=7,wg=3,warp=5.1,time=1000-90000"
+  // 出错时返回 false 并在 err 中给出原因
+  bool parse(const char* spec, std::string& err);
+  bool all() const;
+  bool wgSampled(uint32_t software_wg_id, uint64_t time) const;
+  bool warpChecked(uint32_t software_wg_id, uint32_t software_warp_id) const;
+};
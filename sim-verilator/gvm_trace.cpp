@@ -0,0 +1,257 @@
+// GVM 录制与回放的轨迹文件读写
+
+#include "gvm_trace.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+
+gvm_trace_writer_t g_gvm_trace;
+
+constexpr size_t GZ_CHUNK_MAX = 1u << 30; // 单次 gzwrite/gzread 的最大长度，须能表示为 int
+
+static_assert(std::is_trivially_copyable_v<Cta2WarpData>);
+static_assert(std::is_trivially_copyable_v<InsnDispatchData>);
+static_assert(std::is_trivially_copyable_v<XRegWritebackData>);
+static_assert(std::is_trivially_copyable_v<VRegWritebackData>);
+static_assert(std::is_trivially_copyable_v<BarDoneData>);
+
+static gvm_trace_file_header_t make_file_header() {
+  gvm_trace_file_header_t h{};
+  memcpy(h.magic, GVM_TRACE_MAGIC, sizeof(h.magic));
+  h.version = GVM_TRACE_VERSION;
+  h.sizeof_cta2warp = sizeof(Cta2WarpData);
+  h.sizeof_insn_dispatch = sizeof(InsnDispatchData);
+  h.sizeof_xreg_wb = sizeof(XRegWritebackData);
+  h.sizeof_vreg_wb = sizeof(VRegWritebackData);
+  h.sizeof_bar_done = sizeof(BarDoneData);
+  return h;
+}
+
+//
+// ------------------------- gvm_trace_writer_t ----------------------------------------------
+//
+
+gvm_trace_writer_t::~gvm_trace_writer_t() {
+  close();
+}
+
+bool gvm_trace_writer_t::open(const char* filename) {
+  assert(file == nullptr);
+  configured = true;
+  if (filename == nullptr) {
+    pending.clear();
+    pending.shrink_to_fit();
+    return true;
+  }
+  file = gzopen(filename, "wb1"); // 录制时以写入速度优先
+  if (file == nullptr) {
+    pending.clear();
+    return false;
+  }
+  gzbuffer(file, 1 << 20);
+  const gvm_trace_file_header_t h = make_file_header();
+  write(&h, sizeof(h));
+  for (const auto& call : pending) {
+    write(&call.type, sizeof(call.type));
+    write(&call.header, sizeof(call.header));
+    write(call.data.data(), call.data.size());
+  }
+  pending.clear();
+  pending.shrink_to_fit();
+  return true;
+}
+
+void gvm_trace_writer_t::close() {
+  if (file != nullptr) {
+    gzclose(file);
+    file = nullptr;
+  }
+}
+
+void gvm_trace_writer_t::abandonAfterFork() {
+  file = nullptr; // 有意泄漏：gzclose 会把父进程尚未写出的缓冲数据再写一遍
+}
+
+void gvm_trace_writer_t::write(const void* buf, size_t size) {
+  // gzwrite 的长度为 unsigned、返回值为 int，大块数据（如 copy_to_dev 的内容）分段写入
+  const char* p = static_cast<const char*>(buf);
+  while (size > 0 && file != nullptr) { // 写入失败后 file 为空，之后的写入全部忽略
+    const unsigned n = std::min<size_t>(size, GZ_CHUNK_MAX);
+    if (gzwrite(file, p, n) != static_cast<int>(n)) {
+      int errnum;
+      fprintf(stderr, "GVM trace: write failed (%s), recording stopped\n", gzerror(file, &errnum));
+      gzclose(file);
+      file = nullptr;
+    }
+    p += n;
+    size -= n;
+  }
+}
+
+void gvm_trace_writer_t::cycle(const GvmDutEvents& ev) {
+  if (file == nullptr) {
+    return;
+  }
+  gvm_trace_cycle_header_t h{};
+  h.time = ev.time;
+  h.num_cta2warp = ev.cta2warp.size();
+  h.num_insn_dispatch = ev.insn_dispatch.size();
+  h.num_xreg_wb = ev.xreg_wb.size();
+  h.num_vreg_wb = ev.vreg_wb.size();
+  h.num_bar_done = ev.bar_done.size();
+  for (const auto& x : ev.xregs) {
+    h.num_xregs += x.captured;
+  }
+  const gvm_trace_record_t type = GVM_TRACE_CYCLE;
+  write(&type, sizeof(type));
+  write(&h, sizeof(h));
+  write(ev.cta2warp.data(), ev.cta2warp.size() * sizeof(Cta2WarpData));
+  write(ev.insn_dispatch.data(), ev.insn_dispatch.size() * sizeof(InsnDispatchData));
+  write(ev.xreg_wb.data(), ev.xreg_wb.size() * sizeof(XRegWritebackData));
+  write(ev.vreg_wb.data(), ev.vreg_wb.size() * sizeof(VRegWritebackData));
+  write(ev.bar_done.data(), ev.bar_done.size() * sizeof(BarDoneData));
+  for (uint32_t sm_id = 0; sm_id < ev.xregs.size() && file != nullptr; sm_id++) {
+    const XRegData& x = ev.xregs[sm_id];
+    if (!x.captured) {
+      continue;
+    }
+    const gvm_trace_xreg_header_t xh{ sm_id, x.num_bank, x.num_sgpr_slots };
+    write(&xh, sizeof(xh));
+    write(x.xbanks.data(), x.num_sgpr_slots * sizeof(uint32_t));
+  }
+}
+
+void gvm_trace_writer_t::hostCall(gvm_trace_record_t type, int ret, std::initializer_list<uint64_t> args,
+  const void* data, uint64_t data_size) {
+  if (!wantsHostCalls()) {
+    return;
+  }
+  gvm_trace_host_call_t call;
+  call.type = type;
+  call.header = {};
+  call.header.ret = ret;
+  assert(args.size() <= std::size(call.header.args));
+  std::copy(args.begin(), args.end(), call.header.args);
+  call.header.data_size = data_size;
+  if (!configured) {
+    call.data.assign(static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + data_size);
+    pending.push_back(std::move(call));
+    return;
+  }
+  write(&call.type, sizeof(call.type));
+  write(&call.header, sizeof(call.header));
+  write(data, data_size);
+}
+
+//
+// ------------------------- gvm_trace_reader_t ----------------------------------------------
+//
+
+gvm_trace_reader_t::~gvm_trace_reader_t() {
+  if (file != nullptr) {
+    gzclose(file);
+  }
+}
+
+bool gvm_trace_reader_t::open(const char* filename) {
+  assert(file == nullptr);
+  file = gzopen(filename, "rb");
+  if (file == nullptr) {
+    err = std::string("cannot open ") + filename;
+    return false;
+  }
+  gzbuffer(file, 1 << 20);
+  gvm_trace_file_header_t h;
+  if (!read(&h, sizeof(h)) || memcmp(h.magic, GVM_TRACE_MAGIC, sizeof(h.magic)) != 0) {
+    err = std::string(filename) + " is not a GVM trace";
+    return false;
+  }
+  const gvm_trace_file_header_t expected = make_file_header();
+  if (memcmp(&h, &expected, sizeof(h)) != 0) {
+    err = std::string(filename) + " was recorded by an incompatible build (trace version "
+      + std::to_string(h.version) + ", expected " + std::to_string(GVM_TRACE_VERSION) + ")";
+    return false;
+  }
+  return true;
+}
+
+bool gvm_trace_reader_t::read(void* buf, size_t size) {
+  char* p = static_cast<char*>(buf);
+  while (size > 0) {
+    const unsigned n = std::min<size_t>(size, GZ_CHUNK_MAX);
+    if (gzread(file, p, n) != static_cast<int>(n)) {
+      if (err.empty()) {
+        int errnum;
+        const char* msg = gzerror(file, &errnum);
+        err = std::string("truncated trace") + (errnum != Z_OK ? std::string(": ") + msg : std::string());
+      }
+      return false;
+    }
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+gvm_trace_record_t gvm_trace_reader_t::next(GvmDutEvents& ev, gvm_trace_host_call_t& call) {
+  uint8_t type;
+  if (gzread(file, &type, 1) != 1) {
+    int errnum;
+    const char* msg = gzerror(file, &errnum);
+    if (errnum != Z_OK || !gzeof(file)) {
+      err = std::string("truncated trace: ") + msg;
+    }
+    return GVM_TRACE_EOF;
+  }
+
+  if (type == GVM_TRACE_CYCLE) {
+    assert(ev.empty());
+    auto read_vector = [this](auto& v, uint32_t n) {
+      v.resize(n);
+      return read(v.data(), n * sizeof(v[0]));
+    };
+    gvm_trace_cycle_header_t h;
+    bool ok = read(&h, sizeof(h));
+    ev.time = h.time;
+    ok = ok && read_vector(ev.cta2warp, h.num_cta2warp);
+    ok = ok && read_vector(ev.insn_dispatch, h.num_insn_dispatch);
+    ok = ok && read_vector(ev.xreg_wb, h.num_xreg_wb);
+    ok = ok && read_vector(ev.vreg_wb, h.num_vreg_wb);
+    ok = ok && read_vector(ev.bar_done, h.num_bar_done);
+    for (auto& x : ev.xregs) {
+      x.captured = false;
+    }
+    for (uint32_t i = 0; ok && i < h.num_xregs; i++) {
+      gvm_trace_xreg_header_t xh;
+      ok = read(&xh, sizeof(xh));
+      if (!ok) {
+        break;
+      }
+      if (xh.sm_id >= ev.xregs.size()) {
+        ev.xregs.resize(xh.sm_id + 1);
+      }
+      XRegData& x = ev.xregs[xh.sm_id];
+      x.scope = nullptr;
+      x.num_bank = xh.num_bank;
+      x.num_sgpr_slots = xh.num_sgpr_slots;
+      x.captured = true;
+      ok = read_vector(x.xbanks, xh.num_sgpr_slots);
+    }
+    return ok ? GVM_TRACE_CYCLE : GVM_TRACE_EOF;
+  }
+
+  if (type >= GVM_TRACE_HOST_DEV_OPEN && type <= GVM_TRACE_MEM_CHECK) {
+    call.type = static_cast<gvm_trace_record_t>(type);
+    if (!read(&call.header, sizeof(call.header))) {
+      return GVM_TRACE_EOF;
+    }
+    call.data.resize(call.header.data_size);
+    return read(call.data.data(), call.data.size()) ? call.type : GVM_TRACE_EOF;
+  }
+
+  err = "unknown record type " + std::to_string(type);
+  return GVM_TRACE_EOF;
+}
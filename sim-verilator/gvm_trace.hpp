@@ -0,0 +1,109 @@
+// GVM 录制与回放
+// 录制模式下仿真进程不运行 REF 比对，仅将每周期的 DUT 事件与驱动对 REF 的 fw_vt_* 调用按顺序写入 gzip 压缩的二进制轨迹，
+// 之后由独立的 gvm-replay 工具（gvm_replay.cpp）读取轨迹，驱动 REF 并执行与在线模式相同的 getDut()/gvmStep() 比对。
+//
+// 文件格式：gvm_trace_file_header_t，之后是若干条记录，每条记录以 1 字节的 gvm_trace_record_t 开头
+//   GVM_TRACE_CYCLE       gvm_trace_cycle_header_t，随后依次是各类事件结构体的原始字节，
+//                         最后是 num_xregs 个寄存器堆快照（gvm_trace_xreg_header_t + num_sgpr_slots 个字）
+//   GVM_TRACE_HOST_*      gvm_trace_host_header_t，随后是 data_size 字节的附加数据
+//   GVM_TRACE_MEM_CHECK   kernel 结束时 DUT 写入过的页的哈希，格式同 GVM_TRACE_HOST_*
+
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+#include "gvm_global_var.hpp"
+
+enum gvm_trace_record_t : uint8_t {
+  GVM_TRACE_EOF = 0, // 仅作为 gvm_trace_reader_t::next() 的返回值
+  GVM_TRACE_CYCLE,
+  GVM_TRACE_HOST_DEV_OPEN,
+  GVM_TRACE_HOST_DEV_CLOSE,
+  GVM_TRACE_HOST_BUF_ALLOC,          // args: size, *vaddr（返回值）, BUF_TYPE, taskID, kernelID
+  GVM_TRACE_HOST_BUF_FREE,           // args: size, *vaddr, taskID, kernelID
+  GVM_TRACE_HOST_ONE_BUF_FREE,       // args: size, *vaddr, taskID, kernelID
+  GVM_TRACE_HOST_COPY_TO_DEV,        // args: dev_vaddr, size, taskID, kernelID; data: 拷贝的内容
+  GVM_TRACE_HOST_START,              // args: taskID; data: gvmref_meta_data
+  GVM_TRACE_HOST_UPLOAD_KERNEL_FILE, // args: taskID; data: 文件名, '\0', 文件内容
+  GVM_TRACE_MEM_CHECK,               // 格式同 GVM_TRACE_HOST_*，args: pagesize, 页数; data: 每页的基址与 gvm_t::memHash()
+};
+
+struct gvm_trace_file_header_t {
+  char magic[8];
+  uint32_t version;
+  // 各事件结构体的大小，回放工具据此拒绝不同版本构建录制的轨迹
+  uint32_t sizeof_cta2warp, sizeof_insn_dispatch, sizeof_xreg_wb, sizeof_vreg_wb, sizeof_bar_done;
+};
+constexpr char GVM_TRACE_MAGIC[8] = "VTGVMTR";
+constexpr uint32_t GVM_TRACE_VERSION = 2;
+
+struct gvm_trace_cycle_header_t {
+  uint64_t time;
+  uint32_t num_cta2warp, num_insn_dispatch, num_xreg_wb, num_vreg_wb, num_bar_done;
+  uint32_t num_xregs; // 本周期读取过的 SM 寄存器堆数目
+};
+struct gvm_trace_xreg_header_t {
+  uint32_t sm_id;
+  uint32_t num_bank;
+  uint32_t num_sgpr_slots;
+};
+struct gvm_trace_host_header_t {
+  int32_t ret; // 录制时 REF 接口的返回值
+  uint64_t args[5];
+  uint64_t data_size;
+};
+
+struct gvm_trace_host_call_t {
+  gvm_trace_record_t type;
+  gvm_trace_host_header_t header;
+  std::vector<uint8_t> data;
+};
+
+class gvm_trace_writer_t
+{
+public:
+  gvm_trace_writer_t() = default;
+  ~gvm_trace_writer_t();
+
+  // filename 为空表示不录制。仿真实例创建前驱动可能已调用 fw_vt_*，这些调用先暂存，在此时写入或丢弃
+  bool open(const char* filename);
+  void close();
+  bool recording() const { return file != nullptr; }
+  bool wantsHostCalls() const { return file != nullptr || !configured; } // 为 false 时 hostCall() 什么也不做
+  void cycle(const GvmDutEvents& ev); // 写入一个周期的事件，ev.xregs 中已读取的寄存器堆一并写入
+  void hostCall(gvm_trace_record_t type, int ret, std::initializer_list<uint64_t> args,
+    const void* data = nullptr, uint64_t data_size = 0);
+  // fork 出的快照子进程回滚后会重新仿真已录制过的周期，不能再写入，也不能刷新父进程缓冲区中的数据
+  void abandonAfterFork();
+
+private:
+  void write(const void* buf, size_t size);
+
+  gzFile file = nullptr;
+  bool configured = false; // open() 是否已被调用过
+  std::vector<gvm_trace_host_call_t> pending; // open() 之前的 fw_vt_* 调用
+};
+
+class gvm_trace_reader_t
+{
+public:
+  gvm_trace_reader_t() = default;
+  ~gvm_trace_reader_t();
+
+  bool open(const char* filename); // 失败时 error() 给出原因
+  // 读取下一条记录：周期事件写入 ev（其 vector 须为空），REF 调用写入 call；文件结束或出错时返回 GVM_TRACE_EOF
+  gvm_trace_record_t next(GvmDutEvents& ev, gvm_trace_host_call_t& call);
+  const std::string& error() const { return err; }
+
+private:
+  bool read(void* buf, size_t size);
+
+  gzFile file = nullptr;
+  std::string err;
+};
+
+extern gvm_trace_writer_t g_gvm_trace;
@@ -79,6 +79,9 @@ void gvmref_step(uint32_t software_wg_id, uint32_t software_warp_id, gvmref_step
 // 则将该指令的执行结果返回
 void gvmref_get_xreg(gvmref_xreg_t* ret, uint32_t wg_id, uint32_t warp_id);
 // 获取 spike 的所有 warp 的标量寄存器堆
+int gvmref_read_mem(uint64_t addr, void* data, uint64_t size) __attribute__((weak));
+// 可选：读取 REF 设备内存的 [addr, addr + size)，成功返回 0。用于 kernel 结束时的内存比对
+// 以弱符号声明，REF 未实现时其地址为空指针，GVM 跳过内存比对
 
 }
 
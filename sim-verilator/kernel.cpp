@@ -1,4 +1,5 @@
 #include "kernel.hpp"
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <fstream>
@@ -21,6 +22,139 @@ static void increment_x_then_y_then_z(dim3_t& i, const dim3_t& bound) {
     }
 }
 
+static void increment_y_then_x_then_z(dim3_t& i, const dim3_t& bound) {
+    i.y++;
+    if (i.y >= bound.y) {
+        i.y = 0;
+        i.x++;
+        if (i.x >= bound.x) {
+            i.x = 0;
+            if (i.z < bound.z)
+                i.z++;
+        }
+    }
+}
+
+// x-y平面内按tile_x * tile_y的tile分块，tile内与tile间均为row-major，边缘的tile可能不完整
+static void increment_tiled(dim3_t& i, const dim3_t& bound, uint32_t tile_x, uint32_t tile_y) {
+    uint32_t x0 = i.x / tile_x * tile_x, y0 = i.y / tile_y * tile_y;
+    uint32_t x1 = std::min(x0 + tile_x, bound.x), y1 = std::min(y0 + tile_y, bound.y);
+    if (++i.x < x1)
+        return;
+    i.x = x0;
+    if (++i.y < y1)
+        return;
+    // 下一个tile
+    i.y = y0;
+    if (x1 < bound.x) {
+        i.x = x1;
+        return;
+    }
+    i.x = 0;
+    if (y1 < bound.y) {
+        i.y = y1;
+        return;
+    }
+    i.y = 0;
+    if (i.z < bound.z)
+        i.z++;
+}
+
+// 将32bit整数的各bit间隔展开到64bit的偶数位
+static uint64_t morton_spread(uint32_t v) {
+    uint64_t x = v;
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFFull;
+    x = (x | (x << 8)) & 0x00FF00FF00FF00FFull;
+    x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0Full;
+    x = (x | (x << 2)) & 0x3333333333333333ull;
+    x = (x | (x << 1)) & 0x5555555555555555ull;
+    return x;
+}
+static uint32_t morton_compact(uint64_t x) {
+    x &= 0x5555555555555555ull;
+    x = (x | (x >> 1)) & 0x3333333333333333ull;
+    x = (x | (x >> 2)) & 0x0F0F0F0F0F0F0F0Full;
+    x = (x | (x >> 4)) & 0x00FF00FF00FF00FFull;
+    x = (x | (x >> 8)) & 0x0000FFFF0000FFFFull;
+    x = (x | (x >> 16)) & 0x00000000FFFFFFFFull;
+    return x;
+}
+
+// 大于code的最小的、落在[0, zmax]对应矩形内的Morton码（BIGMIN，Tropf & Herzog 1981），要求code <= zmax
+static uint64_t morton_bigmin(uint64_t code, uint64_t zmax) {
+    uint64_t zmin = 0, bigmin = zmax;
+    for (int bit = 63; bit >= 0; bit--) {
+        uint64_t mask = 1ull << bit;
+        uint64_t lower = ((bit % 2) ? 0xAAAAAAAAAAAAAAAAull : 0x5555555555555555ull) & (mask - 1); // 同一维的低位
+        bool v = code & mask, lo = zmin & mask, hi = zmax & mask;
+        if (!v && !lo && hi) {
+            bigmin = (zmin | mask) & ~lower;
+            zmax = (zmax & ~mask) | lower;
+        } else if (!v && lo && hi) {
+            return zmin;
+        } else if (v && !lo && !hi) {
+            return bigmin;
+        } else if (v && !lo && hi) {
+            zmin = (zmin | mask) & ~lower;
+        }
+    }
+    return code; // code本身在矩形内
+}
+
+// x-y平面内沿Z-order曲线前进，直接跳到下一个位于grid内的点
+static void increment_morton(dim3_t& i, const dim3_t& bound) {
+    uint64_t zmax = morton_spread(bound.x - 1) | (morton_spread(bound.y - 1) << 1);
+    uint64_t code = (morton_spread(i.x) | (morton_spread(i.y) << 1)) + 1;
+    if (code <= zmax) {
+        code = morton_bigmin(code, zmax);
+        i.x = morton_compact(code);
+        i.y = morton_compact(code >> 1);
+        return;
+    }
+    i.x = 0;
+    i.y = 0;
+    if (i.z < bound.z)
+        i.z++;
+}
+
+void Kernel::increment_next_wg() {
+    switch (m_metadata.wg_order) {
+    case VENTUS_WG_ORDER_COLUMN_MAJOR:
+        increment_y_then_x_then_z(m_next_wg, m_grid_dim);
+        break;
+    case VENTUS_WG_ORDER_MORTON:
+        increment_morton(m_next_wg, m_grid_dim);
+        break;
+    case VENTUS_WG_ORDER_TILED:
+        increment_tiled(m_next_wg, m_grid_dim, m_metadata.wg_order_tile[0], m_metadata.wg_order_tile[1]);
+        break;
+    case VENTUS_WG_ORDER_ROW_MAJOR:
+    default:
+        increment_x_then_y_then_z(m_next_wg, m_grid_dim);
+        break;
+    }
+}
+
+void Kernel::set_wg_order(uint32_t order, uint32_t tile_x, uint32_t tile_y) {
+    assert(order <= VENTUS_WG_ORDER_TILED); // 由ventus_rtlsim_add_kernel*()与命令行解析检查
+    m_metadata.wg_order = order;
+    m_metadata.wg_order_tile[0] = tile_x ? tile_x : 2;
+    m_metadata.wg_order_tile[1] = tile_y ? tile_y : 2;
+}
+
+const char* Kernel::get_wg_order_name() const {
+    switch (m_metadata.wg_order) {
+    case VENTUS_WG_ORDER_COLUMN_MAJOR:
+        return "column-major";
+    case VENTUS_WG_ORDER_MORTON:
+        return "morton";
+    case VENTUS_WG_ORDER_TILED:
+        return "tiled";
+    default:
+        return "row-major";
+    }
+}
+
 int Kernel::charToHex(char c) const {
     if (c >= '0' && c <= '9')
         return c - '0';
@@ -34,9 +168,7 @@ int Kernel::charToHex(char c) const {
 bool Kernel::isHexCharacter(char c) const {
     return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'F') || (c >= 'a' && c <= 'f');
 }
-bool Kernel::no_more_wg_to_dispatch() const {
-    return (m_next_wg.x >= m_grid_dim.x || m_next_wg.y >= m_grid_dim.y || m_next_wg.z >= m_grid_dim.z);
-}
+bool Kernel::no_more_wg_to_dispatch() const { return m_num_wg_running + m_num_wg_finished >= get_num_wg(); }
 uint32_t Kernel::get_next_wg_idx_in_kernel() const {
     return m_next_wg.x + m_grid_dim.x * m_next_wg.y + m_grid_dim.x * m_grid_dim.y * m_next_wg.z;
 }
@@ -44,12 +176,21 @@ uint32_t Kernel::get_next_wgid() const { return m_wgid_base + get_next_wg_idx_in
 void Kernel::wg_dispatched() {
     assert(is_dispatching());
     uint32_t idx = get_next_wg_idx_in_kernel();
-    if (m_wg_status[idx] != WG_STATUS_WAITING) {
+    if (m_wg_dispatched[idx]) {
         logger->critical("Kernel {} WG {} is dispatched twice", m_kernel_name, idx);
     }
-    assert(m_wg_status[idx] == WG_STATUS_WAITING);
-    m_wg_status[idx] = WG_STATUS_RUNNING;
-    increment_x_then_y_then_z(m_next_wg, m_grid_dim);
+    assert(!m_wg_dispatched[idx]);
+    m_wg_dispatched[idx] = true;
+    m_num_wg_running++;
+    increment_next_wg();
+}
+
+void Kernel::wg_status_init() {
+    uint32_t num_wg = m_metadata.kernel_size[0] * m_metadata.kernel_size[1] * m_metadata.kernel_size[2];
+    m_wg_dispatched.assign(num_wg, false);
+    m_wg_finished.assign(num_wg, false);
+    m_num_wg_running = 0;
+    m_num_wg_finished = 0;
 }
 
 Kernel::Kernel(
@@ -62,9 +203,8 @@ Kernel::Kernel(
     , m_finish_callback(nullptr) {
     // Get metadata of this kernel
     initMetaData(metadata_file);
-    // Init thread-block status record vector
-    m_wg_status.resize(m_metadata.kernel_size[0] * m_metadata.kernel_size[1] * m_metadata.kernel_size[2]);
-    std::fill(m_wg_status.begin(), m_wg_status.end(), WG_STATUS_WAITING);
+    // Init thread-block status record
+    wg_status_init();
     m_is_activated = false;
 }
 
@@ -85,9 +225,9 @@ Kernel::Kernel(
     m_grid_dim.x = m_metadata.kernel_size[0];
     m_grid_dim.y = m_metadata.kernel_size[1];
     m_grid_dim.z = m_metadata.kernel_size[2];
-    // Init thread-block status record vector
-    m_wg_status.resize(m_metadata.kernel_size[0] * m_metadata.kernel_size[1] * m_metadata.kernel_size[2]);
-    std::fill(m_wg_status.begin(), m_wg_status.end(), WG_STATUS_WAITING);
+    set_wg_order(m_metadata.wg_order, m_metadata.wg_order_tile[0], m_metadata.wg_order_tile[1]);
+    // Init thread-block status record
+    wg_status_init();
     m_is_activated = false;
 }
 
@@ -145,6 +285,9 @@ void Kernel::initMetaData(const std::string& filename) {
     readHexFile(filename, metadata, 64);
     assignMetadata(metadata, m_metadata);
     m_metadata.name = m_kernel_name.c_str();
+    m_metadata.data = nullptr;
+    m_metadata.stream_id = 0;
+    set_wg_order(VENTUS_WG_ORDER_ROW_MAJOR);
 }
 
 void Kernel::assignMetadata(const std::vector<uint64_t>& metadata, metadata_t& mtd) {
@@ -188,18 +331,17 @@ void Kernel::assignMetadata(const std::vector<uint64_t>& metadata, metadata_t& m
     }
 }
 
-void Kernel::activate(uint32_t kernel_id, uint32_t wgid_base) {
+void Kernel::activate(uint32_t kernel_id, uint32_t wgid_base, uint64_t time) {
     m_kernel_id = kernel_id;
     m_wgid_base = wgid_base;
+    m_time_activated = time;
     m_metadata.kernel_id = kernel_id;
 
     // If it's needed to load data before running kernel, do it
     if (m_load_data_callback)
         m_load_data_callback(&m_metadata);
 
-    for (const auto wg_status : m_wg_status) {
-        assert(wg_status == WG_STATUS_WAITING);
-    }
+    assert(m_num_wg_running == 0 && m_num_wg_finished == 0);
 
     m_is_activated = true;
     logger->trace("kernel{0:>2} {1} activate", get_kid(), get_kname());
@@ -212,36 +354,24 @@ void Kernel::deactivate() {
         m_finish_callback(&m_metadata);
 }
 
-bool Kernel::is_finished() const {
-    for (const auto wg_status : m_wg_status) {
-        if (wg_status != WG_STATUS_FINISHED)
-            return false;
-    }
-    return true;
-}
-bool Kernel::is_running() const {
-    if (!is_activated())
-        return false;
-    for (const auto wg_status : m_wg_status) {
-        if (wg_status == WG_STATUS_RUNNING)
-            return true;
-    }
-    return false;
-}
+bool Kernel::is_finished() const { return m_num_wg_finished == get_num_wg(); }
+bool Kernel::is_running() const { return is_activated() && m_num_wg_running != 0; }
 bool Kernel::is_dispatching() const { return is_activated() && !no_more_wg_to_dispatch(); }
 
 void Kernel::wg_finish(uint32_t wgid) {
     assert(is_wg_belonging(wgid));
     uint32_t idx = wgid - m_wgid_base;
-    assert(m_wg_status[idx] == WG_STATUS_RUNNING);
-    m_wg_status[idx] = WG_STATUS_FINISHED;
+    assert(m_wg_dispatched[idx] && !m_wg_finished[idx]);
+    m_wg_finished[idx] = true;
+    m_num_wg_running--;
+    m_num_wg_finished++;
 }
 
 bool Kernel::is_wg_belonging(uint32_t wg_id, uint32_t* wg_idx_in_kernel) const {
     if (!is_running() || is_finished())
         return false;
 
-    if (wg_id >= m_wgid_base && wg_id < m_wgid_base + get_num_wg()) {
+    if (wg_id - m_wgid_base < get_num_wg()) { // 无符号减法，线程块ID区间回绕时也成立
         if (wg_idx_in_kernel) {
             *wg_idx_in_kernel = wg_id - m_wgid_base;
         }
@@ -250,3 +380,53 @@ bool Kernel::is_wg_belonging(uint32_t wg_id, uint32_t* wg_idx_in_kernel) const {
         return false;
     }
 }
+
+void Kernel::checkpoint_save(CheckpointOut& out) const {
+    out.str(m_kernel_name);
+    metadata_t metadata = m_metadata; // 指针成员单独保存
+    metadata.name = nullptr;
+    metadata.data = nullptr;
+    metadata.buffer_base = metadata.buffer_size = metadata.buffer_allocsize = nullptr;
+    out.pod(metadata);
+    for (const uint64_t* array : { m_metadata.buffer_base, m_metadata.buffer_size, m_metadata.buffer_allocsize }) {
+        out.write(array, m_metadata.num_buffer * sizeof(uint64_t));
+    }
+    out.pod(m_kernel_id);
+    out.pod(m_wgid_base);
+    out.pod(m_next_wg);
+    out.vec(m_wg_dispatched);
+    out.vec(m_wg_finished);
+    out.pod(m_num_wg_running);
+    out.pod(m_num_wg_finished);
+    out.pod(m_is_activated);
+    out.pod(m_time_activated);
+}
+
+std::shared_ptr<Kernel> Kernel::checkpoint_restore(
+    CheckpointIn& in, std::function<void(const metadata_t*)> data_load_callback,
+    std::function<void(const metadata_t*)> finish_callback, std::shared_ptr<spdlog::logger> logger
+) {
+    std::string name = in.str();
+    metadata_t metadata = in.pod<metadata_t>();
+    std::vector<uint64_t> buffers(metadata.num_buffer * 3);
+    in.read(buffers.data(), buffers.size() * sizeof(uint64_t));
+    metadata.name = name.c_str();
+
+    auto kernel = std::make_shared<Kernel>(&metadata, data_load_callback, finish_callback, logger);
+    kernel->m_metadata.name = kernel->m_kernel_name.c_str();
+    kernel->m_buffer_storage = std::move(buffers);
+    kernel->m_metadata.buffer_base = kernel->m_buffer_storage.data();
+    kernel->m_metadata.buffer_size = kernel->m_metadata.buffer_base + metadata.num_buffer;
+    kernel->m_metadata.buffer_allocsize = kernel->m_metadata.buffer_size + metadata.num_buffer;
+    in.pod(kernel->m_kernel_id);
+    in.pod(kernel->m_wgid_base);
+    in.pod(kernel->m_next_wg);
+    in.vec(kernel->m_wg_dispatched);
+    in.vec(kernel->m_wg_finished);
+    in.pod(kernel->m_num_wg_running);
+    in.pod(kernel->m_num_wg_finished);
+    in.pod(kernel->m_is_activated);
+    in.pod(kernel->m_time_activated);
+    assert(kernel->m_wg_dispatched.size() == kernel->get_num_wg());
+    return kernel;
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include "checkpoint.hpp"
 #include "ventus_rtlsim.h"
 #include <cstdint>
 #include <filesystem>
@@ -28,11 +29,18 @@ public:
     uint32_t get_kid() const { return m_kernel_id; }
     std::string get_kname() const { return m_kernel_name; }
     const metadata_t* get_metadata() const { return &m_metadata; }
+    uint64_t get_stream_id() const { return m_metadata.stream_id; }
+    void set_stream_id(uint64_t stream_id) { m_metadata.stream_id = stream_id; }
+    uint32_t get_wg_order() const { return m_metadata.wg_order; }
+    const char* get_wg_order_name() const;
+    void set_wg_order(uint32_t order, uint32_t tile_x = 0, uint32_t tile_y = 0);
+    uint64_t get_time_activated() const { return m_time_activated; }
 
     bool no_more_wg_to_dispatch() const;
     dim3_t get_next_wg_idx3d_in_kernel() const { return m_next_wg; }
     uint32_t get_next_wg_idx_in_kernel() const;
     uint32_t get_next_wgid() const;
+    uint32_t get_wgid_base() const { return m_wgid_base; }
     void wg_dispatched();
 
     dim3_t get_num_wg_3d() const { return m_grid_dim; }
@@ -61,9 +69,18 @@ public:
     bool is_activated() const { return m_is_activated; }
 
     // Load kernel init data (testcase.data file) and get ready to run
-    void activate(uint32_t kernel_id, uint32_t wgid_base);
+    void activate(uint32_t kernel_id, uint32_t wgid_base, uint64_t time = 0);
     void deactivate();
     const std::function<void(const metadata_t*)> m_finish_callback; // call this after kernel finished
+    bool has_data_load_callback() const { return m_load_data_callback != nullptr; }
+
+    // 检查点：保存/恢复metadata与线程块状态
+    // 回调函数与metadata.data无法保存，恢复时由调用者重新提供，metadata.data置为nullptr
+    void checkpoint_save(CheckpointOut& out) const;
+    static std::shared_ptr<Kernel> checkpoint_restore(
+        CheckpointIn& in, std::function<void(const metadata_t*)> data_load_callback,
+        std::function<void(const metadata_t*)> finish_callback, std::shared_ptr<spdlog::logger> logger
+    );
 
     const std::filesystem::path m_datafile;
 
@@ -82,17 +99,24 @@ private:
     void initMetaData(const std::string& filename);
     void assignMetadata(const std::vector<uint64_t>& metadata, metadata_t& mtd);
     std::function<void(const metadata_t*)> m_load_data_callback;
+    std::vector<uint64_t> m_buffer_storage; // 从检查点恢复的kernel自行持有metadata中的buffer_*数组
 
     // Get new thread-block
+    void increment_next_wg(); // 按m_metadata.wg_order前进到下一个线程块
     dim3_t m_next_wg = { 0, 0, 0 }; // start from 0 ~ (grid_dim - 1)
     dim3_t m_grid_dim;
 
-    // Thread-block(workgroup) status: waiting, running, finished
-    enum { WG_STATUS_WAITING, WG_STATUS_RUNNING, WG_STATUS_FINISHED };
-    std::vector<int> m_wg_status;
+    // Thread-block(workgroup) status: waiting, running(dispatched but not finished), finished
+    // 每个线程块用2个bit记录状态，另用计数器使kernel状态查询为O(1)
+    void wg_status_init();
+    std::vector<bool> m_wg_dispatched;
+    std::vector<bool> m_wg_finished;
+    uint32_t m_num_wg_running;
+    uint32_t m_num_wg_finished;
 
     // Kernel status
     bool m_is_activated; // activated: data loaded to memory and ready to run
+    uint64_t m_time_activated = 0;
 
     std::shared_ptr<spdlog::logger> logger;
 };
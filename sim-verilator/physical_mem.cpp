@@ -1,15 +1,272 @@
 #include "physical_mem.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PMEM_X86_SIMD 1
+#endif
+
+//
+// Masked byte blend helpers for write_masked()
+// Each 32-bit mask word covers 32 data bytes. All-ones/all-zeros words are special-cased.
+//
+
+// 通用版本：从mask的第bit_offset个bit开始，逐字节写入
+static void blend_bytes_scalar(
+    uint8_t* dst, const uint8_t* src, const uint32_t* mask, uint64_t bit_offset, uint64_t size
+) {
+    for (uint64_t i = 0; i < size; i++) {
+        uint64_t bit = bit_offset + i;
+        if ((mask[bit / 32] >> (bit % 32)) & 0x1) {
+            dst[i] = src[i];
+        }
+    }
+}
+
+static void blend_words_scalar(uint8_t* dst, const uint8_t* src, const uint32_t* mask, uint64_t nwords) {
+    for (uint64_t w = 0; w < nwords; w++, dst += 32, src += 32) {
+        uint32_t m = mask[w];
+        if (m == 0xFFFFFFFFu) {
+            std::memcpy(dst, src, 32);
+            continue;
+        }
+        while (m) {
+            int b = __builtin_ctz(m);
+            dst[b] = src[b];
+            m &= m - 1;
+        }
+    }
+}
+
+#ifdef PMEM_X86_SIMD
+// 将16bit掩码展开为16字节掩码（0x00/0xFF）
+__attribute__((target("sse4.1"))) static inline __m128i expand_mask16_sse(uint16_t m) {
+    const __m128i shuf = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1);
+    const __m128i bitsel = _mm_set1_epi64x(0x8040201008040201LL);
+    __m128i v = _mm_shuffle_epi8(_mm_set1_epi16(m), shuf);
+    return _mm_cmpeq_epi8(_mm_and_si128(v, bitsel), bitsel);
+}
+
+__attribute__((target("sse4.1"))) static void blend_words_sse41(
+    uint8_t* dst, const uint8_t* src, const uint32_t* mask, uint64_t nwords
+) {
+    for (uint64_t w = 0; w < nwords; w++, dst += 32, src += 32) {
+        uint32_t m = mask[w];
+        if (m == 0)
+            continue;
+        if (m == 0xFFFFFFFFu) {
+            std::memcpy(dst, src, 32);
+            continue;
+        }
+        for (int half = 0; half < 2; half++) {
+            __m128i sel = expand_mask16_sse(m >> (half * 16));
+            __m128i old = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + half * 16));
+            __m128i new_ = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + half * 16));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + half * 16), _mm_blendv_epi8(old, new_, sel));
+        }
+    }
+}
+
+__attribute__((target("avx2"))) static void blend_words_avx2(
+    uint8_t* dst, const uint8_t* src, const uint32_t* mask, uint64_t nwords
+) {
+    // 每个128bit lane内的shuffle：低lane取mask的byte0/1，高lane取byte2/3
+    const __m256i shuf = _mm256_setr_epi8(
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3
+    );
+    const __m256i bitsel = _mm256_set1_epi64x(0x8040201008040201LL);
+    for (uint64_t w = 0; w < nwords; w++, dst += 32, src += 32) {
+        uint32_t m = mask[w];
+        if (m == 0)
+            continue;
+        if (m == 0xFFFFFFFFu) {
+            std::memcpy(dst, src, 32);
+            continue;
+        }
+        __m256i v = _mm256_shuffle_epi8(_mm256_set1_epi32(m), shuf);
+        __m256i sel = _mm256_cmpeq_epi8(_mm256_and_si256(v, bitsel), bitsel);
+        __m256i old = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst));
+        __m256i new_ = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_blendv_epi8(old, new_, sel));
+    }
+}
+#endif // PMEM_X86_SIMD
+
+static bool mask_is_empty(const uint32_t* mask, uint64_t bit_offset, uint64_t size) {
+    uint64_t bit = bit_offset;
+    uint64_t end = bit_offset + size;
+    while (bit < end) {
+        uint64_t nbits = std::min<uint64_t>(32 - bit % 32, end - bit);
+        uint32_t m = mask[bit / 32] >> (bit % 32);
+        if (nbits < 32)
+            m &= (1u << nbits) - 1;
+        if (m != 0)
+            return false;
+        bit += nbits;
+    }
+    return true;
+}
+
+typedef void (*blend_words_fn)(uint8_t* dst, const uint8_t* src, const uint32_t* mask, uint64_t nwords);
+
+// 运行时根据CPU支持的指令集选择实现，构建时无需-march
+static blend_words_fn select_blend_words() {
+#ifdef PMEM_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return blend_words_avx2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return blend_words_sse41;
+#endif // PMEM_X86_SIMD
+    return blend_words_scalar;
+}
+static const blend_words_fn blend_words = select_blend_words();
+
+//
+// Page table
+//
+
+static uint8_t* page_new(uint64_t pagesize) { return new (std::align_val_t(4096)) uint8_t[pagesize]; }
+static void page_delete(uint8_t* page) { ::operator delete[](page, std::align_val_t(4096)); }
+
+PhysicalMemory::PhysicalMemory(
+    bool auto_alloc, uint64_t pagesize, std::shared_ptr<spdlog::logger> logger_, backend_t backend
+)
+    : m_auto_alloc(auto_alloc)
+    , m_pagesize(pagesize)
+    , logger(logger_) {
+    if (m_pagesize == 0 || (m_pagesize & (m_pagesize - 1)) != 0 || m_pagesize >= (1ull << PMEM_ADDR_BITS)) {
+        logger->error("PMEM pagesize {} is not a power of 2, set to default: 4096", m_pagesize);
+        m_pagesize = 4096;
+    }
+    m_page_bits = __builtin_ctzll(m_pagesize);
+    uint32_t page_num_bits = PMEM_ADDR_BITS - m_page_bits;
+    m_dirty_bitmap = std::make_unique<uint64_t[]>(((1ull << page_num_bits) + 63) / 64);
+
+    if (backend == BACKEND_MMAP) {
+        // MAP_PRIVATE: snapshot_fork()得到的子进程与父进程以写时复制方式共享设备内存
+        // MAP_NORESERVE: 只为实际写入过的OS页占用内存
+        void* arena = mmap(
+            nullptr, 1ull << PMEM_ADDR_BITS, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1,
+            0
+        );
+        if (arena != MAP_FAILED) {
+            m_arena = static_cast<uint8_t*>(arena);
+            m_alloc_bitmap = std::make_unique<uint64_t[]>(((1ull << page_num_bits) + 63) / 64);
+            return;
+        }
+        logger->error(
+            "PMEM mmap backend: failed to reserve {}-bit address space, fallback to pagetable", PMEM_ADDR_BITS
+        );
+    }
+    m_l2_bits = std::min<uint32_t>(page_num_bits, 10); // pagesize=4096时：1024 x 1024
+    m_table = std::make_unique<std::unique_ptr<uint8_t*[]>[]>(1ull << (page_num_bits - m_l2_bits));
+}
+
+bool PhysicalMemory::bitmap_test(paddr_t page_base) const {
+    uint64_t page_num = page_base >> m_page_bits;
+    return (m_alloc_bitmap[page_num / 64] >> (page_num % 64)) & 0x1;
+}
+
+void PhysicalMemory::bitmap_set(paddr_t page_base, bool value) {
+    uint64_t page_num = page_base >> m_page_bits;
+    if (value) {
+        m_alloc_bitmap[page_num / 64] |= 1ull << (page_num % 64);
+    } else {
+        m_alloc_bitmap[page_num / 64] &= ~(1ull << (page_num % 64));
+    }
+}
+
+uint8_t*& PhysicalMemory::page_entry(paddr_t page_base) const {
+    uint64_t page_num = page_base >> m_page_bits;
+    return m_table[page_num >> m_l2_bits][page_num & ((1ull << m_l2_bits) - 1)];
+}
+
+uint8_t* PhysicalMemory::page_lookup(paddr_t page_base) const {
+    if (page_base >> PMEM_ADDR_BITS)
+        return nullptr;
+    if (m_arena)
+        return bitmap_test(page_base) ? m_arena + page_base : nullptr;
+    if (!m_table[(page_base >> m_page_bits) >> m_l2_bits])
+        return nullptr;
+    return page_entry(page_base);
+}
+
+uint8_t* PhysicalMemory::page_get_for_write(paddr_t paddr) {
+    paddr_t page_base = get_page_base(paddr);
+    if (m_cache_wr.base == page_base)
+        return m_cache_wr.page;
+    uint8_t* page = page_lookup(page_base);
+    if (page == nullptr) {
+        if (!m_auto_alloc) {
+            logger->critical("PMEM page at 0x{:x} not allocated, cannot write", paddr);
+            return nullptr;
+        }
+        if (!page_alloc(page_base))
+            return nullptr;
+        page = page_lookup(page_base);
+    }
+    m_cache_wr = { page_base, page };
+    dirty_mark(page_base);
+    return page;
+}
+
+void PhysicalMemory::dirty_mark(paddr_t page_base) {
+    uint64_t page_num = page_base >> m_page_bits;
+    uint64_t& word = m_dirty_bitmap[page_num / 64];
+    if (!((word >> (page_num % 64)) & 0x1)) {
+        word |= 1ull << (page_num % 64);
+        m_dirty_pages.push_back(page_base);
+    }
+}
+
+void PhysicalMemory::dirty_clear() {
+    for (paddr_t page_base : m_dirty_pages) {
+        uint64_t page_num = page_base >> m_page_bits;
+        m_dirty_bitmap[page_num / 64] &= ~(1ull << (page_num % 64));
+    }
+    m_dirty_pages.clear();
+    m_cache_wr = {};
+}
 
 bool PhysicalMemory::page_alloc(paddr_t paddr) {
     if (paddr % m_pagesize != 0) {
         logger->warn("PMEM address 0x{:x} is not aligned to page! Align it...", paddr);
         paddr = get_page_base(paddr);
     }
-    if (!m_auto_alloc && m_map.find(paddr) != m_map.end()) {
-        logger->error("PMEM page at 0x{:x} duplicate allocation", paddr);
+    if (paddr >> PMEM_ADDR_BITS) {
+        logger->error("PMEM page at 0x{:x} is out of {}-bit physical address space", paddr, PMEM_ADDR_BITS);
         return false;
     }
-    m_map[paddr] = new (std::align_val_t(4096)) uint8_t[m_pagesize];
+    if (m_arena) {
+        if (bitmap_test(paddr)) {
+            if (!m_auto_alloc) {
+                logger->error("PMEM page at 0x{:x} duplicate allocation", paddr);
+                return false;
+            }
+            return true;
+        }
+        bitmap_set(paddr, true);
+        m_num_pages++;
+        return true;
+    }
+    std::unique_ptr<uint8_t*[]>& l2 = m_table[(paddr >> m_page_bits) >> m_l2_bits];
+    if (!l2) {
+        l2 = std::make_unique<uint8_t*[]>(1ull << m_l2_bits); // value-initialized: all nullptr
+    }
+    uint8_t*& entry = page_entry(paddr);
+    if (entry != nullptr) {
+        if (!m_auto_alloc) {
+            logger->error("PMEM page at 0x{:x} duplicate allocation", paddr);
+            return false;
+        }
+        return true; // auto_alloc模式下重复分配，保留原页面
+    }
+    entry = page_new(m_pagesize);
+    m_num_pages++;
     return true;
 }
 
@@ -18,15 +275,86 @@ bool PhysicalMemory::page_free(paddr_t paddr) {
         logger->warn("PMEM address 0x{:x} is not aligned to page! Align it...", paddr);
         paddr = get_page_base(paddr);
     }
-    if (m_map.find(paddr) == m_map.end()) {
+    if (page_lookup(paddr) == nullptr) {
         logger->error("PMEM page at 0x{:x} not allocated", paddr);
         return false;
     }
-    delete[] m_map[paddr];
-    m_map.erase(paddr);
+    if (m_arena) {
+        bitmap_set(paddr, false);
+        // 归还物理内存，之后再次读取为全零；页大小不是OS页整数倍时只能清零
+        if (m_pagesize % sysconf(_SC_PAGESIZE) == 0) {
+            madvise(m_arena + paddr, m_pagesize, MADV_DONTNEED);
+        } else {
+            std::memset(m_arena + paddr, 0, m_pagesize);
+        }
+    } else {
+        uint8_t*& entry = page_entry(paddr);
+        page_delete(entry);
+        entry = nullptr;
+    }
+    m_num_pages--;
+    if (m_cache_rd.base == paddr)
+        m_cache_rd = {};
+    if (m_cache_wr.base == paddr)
+        m_cache_wr = {};
     return true;
 }
 
+template <typename F> void PhysicalMemory::page_for_each(F func) const {
+    uint64_t num_pages_total = 1ull << (PMEM_ADDR_BITS - m_page_bits);
+    if (m_arena) {
+        for (uint64_t w = 0; w < (num_pages_total + 63) / 64; w++) {
+            for (uint64_t bits = m_alloc_bitmap[w]; bits; bits &= bits - 1) {
+                paddr_t page_base = (w * 64 + __builtin_ctzll(bits)) << m_page_bits;
+                func(page_base, m_arena + page_base);
+            }
+        }
+        return;
+    }
+    for (uint64_t i = 0; i < (num_pages_total >> m_l2_bits); i++) {
+        if (!m_table[i])
+            continue;
+        for (uint64_t j = 0; j < (1ull << m_l2_bits); j++) {
+            if (m_table[i][j])
+                func(((i << m_l2_bits) | j) << m_page_bits, m_table[i][j]);
+        }
+    }
+}
+
+void PhysicalMemory::checkpoint_save(CheckpointOut& out) const {
+    out.pod(m_pagesize);
+    out.pod(m_num_pages);
+    page_for_each([&](paddr_t page_base, const uint8_t* page) {
+        out.pod(page_base);
+        out.write(page, m_pagesize);
+    });
+    out.vec(m_dirty_pages);
+}
+
+bool PhysicalMemory::checkpoint_restore(CheckpointIn& in) {
+    assert(m_num_pages == 0 && m_dirty_pages.empty());
+    if (in.pod<uint64_t>() != m_pagesize) {
+        logger->error("PMEM checkpoint has a different pagesize");
+        return false;
+    }
+    for (uint64_t n = in.pod<uint64_t>(); n > 0; n--) {
+        paddr_t page_base = in.pod<paddr_t>();
+        if (!page_alloc(page_base))
+            return false;
+        in.read(page_lookup(page_base), m_pagesize);
+    }
+    std::vector<paddr_t> dirty_pages;
+    in.vec(dirty_pages);
+    for (paddr_t page_base : dirty_pages) {
+        dirty_mark(page_base);
+    }
+    return true;
+}
+
+//
+// Memory access
+//
+
 bool PhysicalMemory::write(paddr_t paddr, const void* data_, const bool mask[], uint64_t size) {
     const uint8_t* data = static_cast<const uint8_t*>(data_);
     paddr_t first_page_base = get_page_base(paddr);
@@ -37,15 +365,10 @@ bool PhysicalMemory::write(paddr_t paddr, const void* data_, const bool mask[],
             return false;
         size = size_this_copy;
     }
-    if (m_map.find(first_page_base) == m_map.end()) {
-        if (m_auto_alloc) {
-            page_alloc(first_page_base);
-        } else {
-            logger->critical("PMEM page at 0x{:x} not allocated, cannot write", paddr);
-            return false;
-        }
-    }
-    uint8_t* buf = m_map.at(first_page_base) + paddr - first_page_base;
+    uint8_t* page = page_get_for_write(paddr);
+    if (page == nullptr)
+        return false;
+    uint8_t* buf = page + paddr - first_page_base;
     for (uint64_t i = 0; i < size; i++) {
         if (mask[i]) {
             buf[i] = data[i];
@@ -64,16 +387,44 @@ bool PhysicalMemory::write(paddr_t paddr, const void* data_, uint64_t size) {
             return false;
         size = size_this_copy;
     }
-    if (m_map.find(first_page_base) == m_map.end()) {
-        if (m_auto_alloc) {
-            page_alloc(first_page_base);
-        } else {
-            logger->critical("PMEM page at 0x{:x} not allocated, cannot write", paddr);
-            return false;
+    uint8_t* page = page_get_for_write(paddr);
+    if (page == nullptr)
+        return false;
+    uint8_t* buf = page + paddr - first_page_base;
+    std::memcpy(buf, data, size);
+    return true;
+}
+
+bool PhysicalMemory::write_masked(paddr_t paddr, const void* data_, const uint32_t* packed_mask, uint64_t size) {
+    const uint8_t* data = static_cast<const uint8_t*>(data_);
+    uint64_t bit_offset = 0; // 当前页对应的mask起始bit
+    while (size > 0) {
+        paddr_t page_base = get_page_base(paddr);
+        uint64_t size_this_copy = std::min<uint64_t>(size, page_base + m_pagesize - paddr);
+
+        // 全零掩码不写入任何字节，无需访问页面
+        if (!mask_is_empty(packed_mask, bit_offset, size_this_copy)) {
+            uint8_t* page = page_get_for_write(paddr);
+            if (page == nullptr)
+                return false;
+            uint8_t* buf = page + paddr - page_base;
+            if (bit_offset % 32 == 0) {
+                uint64_t nwords = size_this_copy / 32;
+                blend_words(buf, data, packed_mask + bit_offset / 32, nwords);
+                blend_bytes_scalar(
+                    buf + nwords * 32, data + nwords * 32, packed_mask, bit_offset + nwords * 32,
+                    size_this_copy - nwords * 32
+                );
+            } else { // 跨页时mask未对齐到32bit，走通用路径
+                blend_bytes_scalar(buf, data, packed_mask, bit_offset, size_this_copy);
+            }
         }
+
+        paddr += size_this_copy;
+        data += size_this_copy;
+        bit_offset += size_this_copy;
+        size -= size_this_copy;
     }
-    uint8_t* buf = m_map.at(first_page_base) + paddr - first_page_base;
-    std::memcpy(buf, data, size);
     return true;
 }
 
@@ -87,21 +438,42 @@ bool PhysicalMemory::read(paddr_t paddr, void* data_, uint64_t size) const {
         success = read(first_page_end + 1, data + size_this_copy, size - size_this_copy);
         size = size_this_copy;
     }
-    if (m_map.find(first_page_base) == m_map.end()) {
-        logger->error("PMEM page at 0x{:x} not allocated, read as all zero", paddr);
-        std::memset(data, 0, size);
-        return false;
+    uint8_t* page;
+    if (m_cache_rd.base == first_page_base) {
+        page = m_cache_rd.page;
+    } else {
+        page = page_lookup(first_page_base);
+        if (page == nullptr && m_arena && m_auto_alloc && !(first_page_base >> PMEM_ADDR_BITS)) {
+            page = m_arena + first_page_base; // 未触及的页，映射到内核共享零页，无需分配
+        } else if (page == nullptr) {
+            logger->error("PMEM page at 0x{:x} not allocated, read as all zero", paddr);
+            std::memset(data, 0, size);
+            return false;
+        }
+        m_cache_rd = { first_page_base, page };
     }
-    uint8_t* buf = m_map.at(first_page_base) + paddr - first_page_base;
+    uint8_t* buf = page + paddr - first_page_base;
     std::memcpy(data, buf, size);
     return success;
 }
 
 PhysicalMemory::~PhysicalMemory() {
-    if(!m_auto_alloc && !m_map.empty()) {
+    if (!m_auto_alloc && m_num_pages != 0) {
         logger->warn("PMEM pages not freed before destruction");
     }
-    for (auto& [paddr, ptr] : m_map) {
-        delete[] ptr;
+    if (m_arena) {
+        munmap(m_arena, 1ull << PMEM_ADDR_BITS);
+        return;
+    }
+    if (!m_table)
+        return;
+    uint64_t l1_size = 1ull << (PMEM_ADDR_BITS - m_page_bits - m_l2_bits);
+    for (uint64_t i = 0; i < l1_size; i++) {
+        if (!m_table[i])
+            continue;
+        for (uint64_t j = 0; j < (1ull << m_l2_bits); j++) {
+            if (m_table[i][j])
+                page_delete(m_table[i][j]);
+        }
     }
 }
@@ -1,32 +1,83 @@
 #pragma once
 
+#include "checkpoint.hpp"
 #include <cstdint>
-#include <map>
 #include <memory>
 #include <spdlog/logger.h>
+#include <vector>
 
 typedef uint64_t paddr_t;
 
+// 设备物理地址宽度，与RTL中的addrLen一致 (ventus/src/top/parameters.scala)
+constexpr uint32_t PMEM_ADDR_BITS = 32;
+
 class PhysicalMemory {
 public:
-    PhysicalMemory() {}
-    PhysicalMemory(bool auto_alloc, uint64_t pagesize, std::shared_ptr<spdlog::logger> logger_)
-        : m_auto_alloc(auto_alloc)
-        , m_pagesize(pagesize)
-        , logger(logger_) { }
+    enum backend_t {
+        BACKEND_PAGETABLE, // 每页单独new分配，由两级页表索引
+        BACKEND_MMAP,      // mmap预留整个物理地址空间，直接按地址索引；未触及的页读取自内核共享零页
+    };
+
+    PhysicalMemory() = delete; // 页表由下面的构造函数建立，未建立时无法访问
+    // pagesize must be a power of 2
+    PhysicalMemory(
+        bool auto_alloc, uint64_t pagesize, std::shared_ptr<spdlog::logger> logger_,
+        backend_t backend = BACKEND_PAGETABLE
+    );
     ~PhysicalMemory();
 
     bool page_alloc(paddr_t paddr);
     bool page_free(paddr_t paddr);
     bool write(paddr_t paddr, const void* data, const bool mask[], uint64_t size);
     bool write(paddr_t paddr, const void* data, uint64_t size);
+    // packed_mask: bit i (packed_mask[i/32] >> (i%32)) enables byte i, same layout as Verilator VlWide
+    bool write_masked(paddr_t paddr, const void* data, const uint32_t* packed_mask, uint64_t size);
     bool read(paddr_t paddr, void* data, uint64_t size) const ;
-    inline paddr_t get_page_base(paddr_t paddr) const { return paddr - paddr % m_pagesize; }
+    inline paddr_t get_page_base(paddr_t paddr) const { return paddr & ~(m_pagesize - 1); }
+    uint64_t get_pagesize() const { return m_pagesize; }
+    const uint8_t* page_data(paddr_t page_base) const { return page_lookup(page_base); } // 页未分配时返回nullptr
+
+    // 脏页跟踪：自上次dirty_clear()以来写入过的页（按首次写入顺序，可能含已释放的页），用于kernel结束时的内存比对
+    const std::vector<paddr_t>& dirty_pages() const { return m_dirty_pages; }
+    void dirty_clear();
+
+    // 检查点：保存/恢复所有已分配的页与脏页记录，只能恢复到新建的、pagesize相同的PhysicalMemory
+    void checkpoint_save(CheckpointOut& out) const;
+    bool checkpoint_restore(CheckpointIn& in);
 
 private:
     const bool m_auto_alloc = false;
-    const uint64_t m_pagesize = 4096;
+    uint64_t m_pagesize = 4096;
     std::shared_ptr<spdlog::logger> logger = nullptr;
 
-    std::map<paddr_t, uint8_t*> m_map;
+    // 两级基数页表：页号 = paddr >> m_page_bits，高位索引第一级，低m_l2_bits位索引第二级
+    // 第二级表按需分配
+    uint32_t m_page_bits = 0;
+    uint32_t m_l2_bits = 0;
+    std::unique_ptr<std::unique_ptr<uint8_t*[]>[]> m_table;
+    uint64_t m_num_pages = 0; // 已分配的页数
+
+    // BACKEND_MMAP: 整个地址空间的映射，以及每页一个bit的分配位图（用于auto_alloc=0时的检查）
+    uint8_t* m_arena = nullptr;
+    std::unique_ptr<uint64_t[]> m_alloc_bitmap;
+    bool bitmap_test(paddr_t page_base) const;
+    void bitmap_set(paddr_t page_base, bool value);
+
+    // 读/写端口各自缓存最近访问的一个页，page_free时失效
+    struct page_cache_t {
+        paddr_t base = UINT64_MAX;
+        uint8_t* page = nullptr;
+    };
+    mutable page_cache_t m_cache_rd;
+    mutable page_cache_t m_cache_wr;
+
+    // 每页一个bit，只在写端口缓存未命中时标记，因此dirty_clear()须同时使写端口缓存失效
+    std::unique_ptr<uint64_t[]> m_dirty_bitmap;
+    std::vector<paddr_t> m_dirty_pages;
+    void dirty_mark(paddr_t page_base);
+
+    uint8_t*& page_entry(paddr_t page_base) const; // page_base必须在地址空间内，且对应的第二级表已分配
+    uint8_t* page_lookup(paddr_t page_base) const; // 页未分配时返回nullptr
+    uint8_t* page_get_for_write(paddr_t paddr);    // 页未分配时按auto_alloc自动分配，失败返回nullptr
+    template <typename F> void page_for_each(F func) const; // 按地址顺序遍历已分配的页：func(page_base, page)
 };
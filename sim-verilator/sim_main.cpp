@@ -2,10 +2,14 @@
 #include "ventus_rtlsim.h"
 #include <cassert>
 #include <cstring>
+#include <fcntl.h>
 #include <fmt/core.h>
 #include <fstream>
 #include <memory>
 #include <spdlog/spdlog.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 extern int parse_arg(
     std::vector<std::string> args, ventus_rtlsim_config_t* config,
@@ -19,6 +23,21 @@ typedef struct {
 
 void kernel_load_data_callback(const metadata_t* metadata);
 
+// 二进制kernel数据格式（小端序），由data2bin.py从.metadata + .data文本文件转换得到
+// header, buffer table, 各buffer原始字节
+static const char KERNEL_DATA_BIN_MAGIC[8] = { 'V', 'T', 'K', 'D', 'A', 'T', 'A', '\0' };
+constexpr uint32_t KERNEL_DATA_BIN_VERSION = 1;
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_buffer;
+} kernel_data_bin_header_t;
+typedef struct {
+    uint64_t base;   // buffer在设备物理内存中的基址
+    uint64_t size;   // buffer字节数
+    uint64_t offset; // buffer数据在文件中的位置
+} kernel_data_bin_buffer_t;
+
 int main(int argc, char* argv[]) {
     spdlog::set_level(spdlog::level::trace);
     const char* verilator_argv[] = {
@@ -69,23 +88,16 @@ int main(int argc, char* argv[]) {
     parse_arg(args, &sim_config_1, f_new_kernel, &dumpmem_ranges);
 
     //
-    // Run simulation, each step stands for 1 simulation time-unit
+    // Run simulation until all kernels finished (or error/time exceeded)
     //
-    const ventus_rtlsim_step_result_t* result;
-    while (1) {
-        result = ventus_rtlsim_step(sim);
-        if (result->error || result->idle || result->time_exceed) {
-            break;
-        }
-    }
+    ventus_rtlsim_run_result_t result;
+    ventus_rtlsim_run(sim, UINT64_MAX, VENTUS_RTLSIM_STOP_IDLE, &result);
 
     //
     // Finish simulation, release resources
     //
-    if (!result->error && !result->time_exceed && result->idle) {
-        for (int i = 0; i < 10000; i++) {
-            ventus_rtlsim_step(sim); // 额外运行一会儿，等待缓存invalidate结束
-        }
+    if (!result.status.error && !result.status.time_exceed && result.status.idle) {
+        ventus_rtlsim_run(sim, 5000, 0, nullptr); // 额外运行一会儿，等待缓存invalidate结束
     }
     for (const auto& range : dumpmem_ranges) { // 命令行参数要求输出的内存内容，每4字节输出1行
         paddr_t begin = range.first;
@@ -106,7 +118,83 @@ int main(int argc, char* argv[]) {
     return 0;
 }
 
+static bool kernel_load_data_binary(const metadata_t* metadata, int fd, uint64_t filesize);
+static void kernel_load_data_text(const metadata_t* metadata);
+
 void kernel_load_data_callback(const metadata_t* metadata) {
+    kernel_load_data_callback_t* cb_data = (kernel_load_data_callback_t*)metadata->data;
+    int fd = open(cb_data->datafile.c_str(), O_RDONLY);
+    if (fd < 0) {
+        spdlog::critical("Failed to open .data file: {}", cb_data->datafile.c_str());
+        assert(0);
+    }
+
+    // 根据文件头判断是二进制格式还是文本格式
+    struct stat st;
+    kernel_data_bin_header_t header;
+    bool is_binary = fstat(fd, &st) == 0 && st.st_size >= sizeof(header)
+        && pread(fd, &header, sizeof(header), 0) == sizeof(header)
+        && std::memcmp(header.magic, KERNEL_DATA_BIN_MAGIC, sizeof(header.magic)) == 0;
+    if (is_binary) {
+        if (!kernel_load_data_binary(metadata, fd, st.st_size)) {
+            spdlog::critical("Failed to load binary kernel data file: {}", cb_data->datafile.c_str());
+            assert(0);
+        }
+        close(fd);
+    } else {
+        close(fd);
+        kernel_load_data_text(metadata);
+    }
+    spdlog::trace(fmt::format("kernel{} {} data loaded from file", metadata->kernel_id, metadata->name));
+}
+
+// 将整个文件mmap后直接拷贝到设备内存
+static bool kernel_load_data_binary(const metadata_t* metadata, int fd, uint64_t filesize) {
+    kernel_load_data_callback_t* cb_data = (kernel_load_data_callback_t*)metadata->data;
+    void* map = mmap(nullptr, filesize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        spdlog::error("mmap failed: {}", strerror(errno));
+        return false;
+    }
+    madvise(map, filesize, MADV_SEQUENTIAL);
+    const uint8_t* file = static_cast<const uint8_t*>(map);
+    const kernel_data_bin_header_t* header = reinterpret_cast<const kernel_data_bin_header_t*>(file);
+    const kernel_data_bin_buffer_t* table = reinterpret_cast<const kernel_data_bin_buffer_t*>(file + sizeof(*header));
+
+    bool success = true;
+    if (header->version != KERNEL_DATA_BIN_VERSION) {
+        spdlog::error("binary kernel data version {} unsupported", header->version);
+        success = false;
+    } else if (header->num_buffer != metadata->num_buffer) {
+        spdlog::error(
+            "binary kernel data has {} buffers, but metadata has {}", header->num_buffer, metadata->num_buffer
+        );
+        success = false;
+    } else if (sizeof(*header) + header->num_buffer * sizeof(*table) > filesize) {
+        spdlog::error("binary kernel data buffer table truncated");
+        success = false;
+    }
+    for (uint32_t i = 0; success && i < header->num_buffer; i++) {
+        const kernel_data_bin_buffer_t& buffer = table[i];
+        if (buffer.base != metadata->buffer_base[i] || buffer.size != metadata->buffer_size[i]) {
+            spdlog::error(
+                "binary kernel data buffer{} [0x{:x}, +{}] mismatches metadata [0x{:x}, +{}]", i, buffer.base,
+                buffer.size, metadata->buffer_base[i], metadata->buffer_size[i]
+            );
+            success = false;
+        } else if (buffer.offset > filesize || buffer.size > filesize - buffer.offset) {
+            spdlog::error("binary kernel data buffer{} out of file range", i);
+            success = false;
+        } else {
+            success = ventus_rtlsim_pmemcpy_h2d(cb_data->sim, buffer.base, file + buffer.offset, buffer.size);
+        }
+    }
+    munmap(map, filesize);
+    return success;
+}
+
+// 文本格式：每行一个32bit字的十六进制表示，按buffer顺序排列
+static void kernel_load_data_text(const metadata_t* metadata) {
     kernel_load_data_callback_t* cb_data = (kernel_load_data_callback_t*)metadata->data;
     std::ifstream file(cb_data->datafile);
     if (!file.is_open()) {
@@ -140,5 +228,4 @@ void kernel_load_data_callback(const metadata_t* metadata) {
     assert(file.eof());
 
     file.close();
-    spdlog::trace(fmt::format("kernel{} {} data loaded from file", metadata->kernel_id, metadata->name));
 }
@@ -0,0 +1,152 @@
+#include "timeline.hpp"
+#include <algorithm>
+#include <cassert>
+#include <fmt/core.h>
+#include <fmt/os.h>
+#include <unordered_map>
+
+Timeline::Timeline(uint64_t capacity, std::shared_ptr<spdlog::logger> logger_)
+    : m_ring(std::max<uint64_t>(capacity, 1))
+    , logger(logger_) {
+    assert(logger);
+}
+
+void Timeline::push(const event_t& event) {
+    if (m_count == m_ring.size()) {
+        m_num_dropped++;
+    } else {
+        m_count++;
+    }
+    m_ring[m_head] = event;
+    m_head = (m_head + 1) % m_ring.size();
+}
+
+void Timeline::kernel_activate(uint64_t time, uint32_t kernel_id, const std::string& kernel_name, uint32_t num_wg) {
+    m_kernel_names[kernel_id] = kernel_name;
+    push({ time, EVENT_KERNEL_ACTIVATE, kernel_id, 0, num_wg });
+}
+void Timeline::kernel_finish(uint64_t time, uint32_t kernel_id) {
+    push({ time, EVENT_KERNEL_FINISH, kernel_id, 0, 0 });
+}
+void Timeline::wg_dispatch(uint64_t time, uint32_t wgid, uint32_t kernel_id, uint32_t wg_idx_in_kernel) {
+    push({ time, EVENT_WG_DISPATCH, kernel_id, wgid, wg_idx_in_kernel });
+}
+void Timeline::wg_on_sm(uint64_t time, uint32_t wgid, uint32_t sm_id) {
+    push({ time, EVENT_WG_ON_SM, 0, wgid, sm_id });
+}
+void Timeline::wg_return(uint64_t time, uint32_t wgid) { push({ time, EVENT_WG_RETURN, 0, wgid, 0 }); }
+
+// 导出格式：
+//   pid 0           所有kernel，每个kernel一个tid
+//   pid 1 + sm_id   各SM上的WG，tid为按时间贪心分配的lane，保证同一lane上的WG互不重叠
+//   pid 0xFFFF      SM未知的WG（非GVM构建中无法获知WG所在SM）
+// 时间戳直接使用仿真时间（单位显示为us）
+bool Timeline::dump(const char* filename, uint64_t time_end) const {
+    constexpr uint32_t PID_KERNEL = 0;
+    constexpr uint32_t PID_SM_UNKNOWN = 0xFFFF;
+    struct span_t {
+        uint64_t begin, end;
+        uint32_t kernel_id, wgid, wg_idx;
+        uint32_t pid;
+        bool finished;
+    };
+    std::vector<span_t> kernels, wgs;
+    std::unordered_map<uint32_t, size_t> kernel_open, wg_open; // id -> index in kernels/wgs
+
+    for (uint64_t i = 0; i < m_count; i++) {
+        const event_t& e = m_ring[(m_head + m_ring.size() - m_count + i) % m_ring.size()];
+        switch (e.type) {
+        case EVENT_KERNEL_ACTIVATE:
+            kernel_open[e.kernel_id] = kernels.size();
+            kernels.push_back({ e.time, time_end, e.kernel_id, 0, e.arg, PID_KERNEL, false });
+            break;
+        case EVENT_WG_DISPATCH:
+            wg_open[e.wgid] = wgs.size();
+            wgs.push_back({ e.time, time_end, e.kernel_id, e.wgid, e.arg, PID_SM_UNKNOWN, false });
+            break;
+        case EVENT_KERNEL_FINISH:
+        case EVENT_WG_ON_SM:
+        case EVENT_WG_RETURN: {
+            auto& open = (e.type == EVENT_KERNEL_FINISH) ? kernel_open : wg_open;
+            auto& spans = (e.type == EVENT_KERNEL_FINISH) ? kernels : wgs;
+            auto it = open.find(e.type == EVENT_KERNEL_FINISH ? e.kernel_id : e.wgid);
+            if (it == open.end()) // 起始事件已被环形缓冲区覆盖
+                break;
+            if (e.type == EVENT_WG_ON_SM) {
+                spans[it->second].pid = 1 + e.arg;
+            } else {
+                spans[it->second].end = e.time;
+                spans[it->second].finished = true;
+                open.erase(it);
+            }
+            break;
+        }
+        }
+    }
+
+    auto kernel_name = [this](uint32_t kernel_id) -> std::string {
+        auto it = m_kernel_names.find(kernel_id);
+        return it == m_kernel_names.end() ? "unknown_kernel" : it->second;
+    };
+
+    try {
+        auto out = fmt::output_file(filename);
+        out.print(
+            "{{\"displayTimeUnit\":\"ns\",\"otherData\":{{\"dropped_events\":{}}},\"traceEvents\":[\n", m_num_dropped
+        );
+        out.print(
+            "{{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":{},\"args\":{{\"name\":\"Kernels\"}}}}", PID_KERNEL
+        );
+        out.print(
+            ",\n{{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":{},\"args\":{{\"name\":\"SM unknown\"}}}}",
+            PID_SM_UNKNOWN
+        );
+        for (const auto& k : kernels) {
+            out.print(
+                ",\n{{\"ph\":\"X\",\"pid\":{},\"tid\":{},\"ts\":{},\"dur\":{},\"name\":\"kernel{} {}\","
+                "\"args\":{{\"num_wg\":{},\"finished\":{}}}}}",
+                PID_KERNEL, k.kernel_id, k.begin, k.end - k.begin, k.kernel_id, kernel_name(k.kernel_id), k.wg_idx,
+                k.finished
+            );
+        }
+
+        // 每个SM内按开始时间贪心分配lane
+        std::stable_sort(wgs.begin(), wgs.end(), [](const span_t& a, const span_t& b) {
+            return a.pid != b.pid ? a.pid < b.pid : a.begin < b.begin;
+        });
+        std::vector<uint64_t> lanes_end; // 每条lane上最后一个WG的结束时间
+        for (size_t i = 0; i < wgs.size(); i++) {
+            const span_t& w = wgs[i];
+            if (i == 0 || wgs[i - 1].pid != w.pid) {
+                lanes_end.clear();
+                if (w.pid != PID_SM_UNKNOWN) {
+                    out.print(
+                        ",\n{{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":{},\"args\":{{\"name\":\"SM {}\"}}}}",
+                        w.pid, w.pid - 1
+                    );
+                }
+            }
+            auto lane = std::find_if(lanes_end.begin(), lanes_end.end(), [&w](uint64_t end) { return end <= w.begin; });
+            if (lane == lanes_end.end()) {
+                lane = lanes_end.insert(lanes_end.end(), w.end);
+            } else {
+                *lane = w.end;
+            }
+            out.print(
+                ",\n{{\"ph\":\"X\",\"pid\":{},\"tid\":{},\"ts\":{},\"dur\":{},\"name\":\"kernel{} {} block{}\","
+                "\"args\":{{\"wg_id\":{},\"kernel_id\":{},\"wg_idx\":{},\"finished\":{}}}}}",
+                w.pid, lane - lanes_end.begin(), w.begin, w.end - w.begin, w.kernel_id, kernel_name(w.kernel_id),
+                w.wg_idx, w.wgid, w.kernel_id, w.wg_idx, w.finished
+            );
+        }
+        out.print("\n]}}\n");
+    } catch (const std::exception& ex) {
+        logger->error("Timeline: failed to write {}: {}", filename, ex.what());
+        return false;
+    }
+    logger->info(
+        "Timeline: {} kernels and {} blocks dumped to {} ({} events dropped)", kernels.size(), wgs.size(), filename,
+        m_num_dropped
+    );
+    return true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <spdlog/logger.h>
+#include <string>
+#include <vector>
+
+// 记录kernel与线程块(WG)生命周期的时间线，存放于环形缓冲区中（满时覆盖最旧事件）
+// 仿真结束时导出为Chrome trace JSON，可用 chrome://tracing 或 https://ui.perfetto.dev 查看
+class Timeline {
+public:
+    Timeline(uint64_t capacity, std::shared_ptr<spdlog::logger> logger);
+
+    void kernel_activate(uint64_t time, uint32_t kernel_id, const std::string& kernel_name, uint32_t num_wg);
+    void kernel_finish(uint64_t time, uint32_t kernel_id);
+    void wg_dispatch(uint64_t time, uint32_t wgid, uint32_t kernel_id, uint32_t wg_idx_in_kernel);
+    void wg_on_sm(uint64_t time, uint32_t wgid, uint32_t sm_id); // WG被分配到的SM，仅GVM构建中可获知
+    void wg_return(uint64_t time, uint32_t wgid);
+
+    bool dump(const char* filename, uint64_t time_end) const;
+
+private:
+    enum event_type_t : uint8_t {
+        EVENT_KERNEL_ACTIVATE,
+        EVENT_KERNEL_FINISH,
+        EVENT_WG_DISPATCH,
+        EVENT_WG_ON_SM,
+        EVENT_WG_RETURN,
+    };
+    struct event_t {
+        uint64_t time;
+        event_type_t type;
+        uint32_t kernel_id;
+        uint32_t wgid;
+        uint32_t arg; // KERNEL_ACTIVATE: num_wg, WG_DISPATCH: wg_idx_in_kernel, WG_ON_SM: sm_id
+    };
+    void push(const event_t& event);
+
+    std::vector<event_t> m_ring;
+    uint64_t m_head = 0;  // 下一个写入位置
+    uint64_t m_count = 0; // 有效事件数
+    uint64_t m_num_dropped = 0;
+    std::map<uint32_t, std::string> m_kernel_names;
+
+    std::shared_ptr<spdlog::logger> logger;
+};
@@ -1,5 +1,13 @@
 #include "ventus_rtlsim_impl.hpp"
 #include "gvmref_interface.h" // apis from spike repo
+#ifdef ENABLE_GVM
+#include "gvm_async.hpp"
+#include "gvm_trace.hpp"
+#include <fstream>
+#include <iterator>
+#include <vector>
+#endif // ENABLE_GVM
+#include <cstring>
 #include <ctime>
 
 static char verilator_rand_seed_setting[128] = "+verilator+seed+10086";
@@ -17,15 +25,45 @@ extern "C" void ventus_rtlsim_get_default_config(ventus_rtlsim_config_t* config)
     config->log.level = "trace";
     config->pmem.pagesize = 4096;
     config->pmem.auto_alloc = 0;
+    config->pmem.backend = "pagetable";
     config->waveform.enable = true;
     config->waveform.time_begin = 0;
     config->waveform.time_end = -1;
     config->waveform.levels = 99;
     config->waveform.filename = "logs/ventus_rtlsim.fst";
+    config->waveform.rolling = 0;
+    config->waveform.rolling_dir = "/dev/shm";
+    for (ventus_waveform_match_t* match : { &config->waveform.trigger.start, &config->waveform.trigger.stop }) {
+        match->kernel_name = NULL;
+        match->kernel_id = -1;
+        match->wg_idx = -1;
+        match->pc = 0;
+        match->addr_base = 0;
+        match->addr_size = 0;
+    }
+    config->waveform.trigger.pre_cycles = 0;
+    config->waveform.trigger.post_cycles = 0;
     config->snapshot.enable = true;
     config->snapshot.time_interval = 100000;
     config->snapshot.num_max = 2;
+    config->snapshot.retention = "fifo";
+    config->snapshot.mem_max = 0;
     config->snapshot.filename = "logs/ventus_rtlsim.snapshot.fst";
+    config->snapshot.rollback = "oldest";
+    config->snapshot.bad_time = 0;
+    config->snapshot.predicate = nullptr;
+    config->snapshot.predicate_arg = nullptr;
+    config->timeline.enable = false;
+    config->timeline.filename = "logs/ventus_rtlsim.trace.json";
+    config->timeline.capacity = 1 << 20;
+    config->cta.concurrent_kernel = false;
+    config->gvm.async = false;
+    config->gvm.queue_depth = 4096;
+    config->gvm.record_file = nullptr;
+    config->gvm.sample = nullptr;
+    config->gvm.report_file = "logs/ventus_rtlsim.gvm_report.json";
+    config->gvm.history_depth = 16;
+    config->gvm.mem_check = false; // 目前的REF未提供gvmref_read_mem()
     config->verilator.argc = 0;
     config->verilator.argv = nullptr;
 
@@ -46,24 +84,62 @@ extern "C" void ventus_rtlsim_finish(ventus_rtlsim_t* sim, bool snapshot_rollbac
     delete sim;
 }
 extern "C" const ventus_rtlsim_step_result_t* ventus_rtlsim_step(ventus_rtlsim_t* sim) { return sim->step(); }
+extern "C" void ventus_rtlsim_run(
+    ventus_rtlsim_t* sim, uint64_t max_cycles, uint32_t stop_mask, ventus_rtlsim_run_result_t* result
+) {
+    ventus_rtlsim_run_result_t result_unused;
+    sim->run(max_cycles, stop_mask, result ? result : &result_unused);
+}
+extern "C" void ventus_rtlsim_set_watch(ventus_rtlsim_t* sim, paddr_t base, uint64_t size) {
+    sim->watch.base = base;
+    sim->watch.size = size;
+}
 extern "C" void ventus_rtlsim_icache_invalidate(ventus_rtlsim_t* sim) { sim->need_icache_invalidate = true; }
 extern "C" uint64_t ventus_rtlsim_get_time(const ventus_rtlsim_t* sim) { return sim->contextp->time(); }
 extern "C" bool ventus_rtlsim_is_idle(const ventus_rtlsim_t* sim) { return sim->cta->is_idle(); }
 
-extern "C" void ventus_rtlsim_add_kernel__delay_data_loading(
+extern "C" bool ventus_rtlsim_checkpoint_save(ventus_rtlsim_t* sim, const char* path) {
+    return sim->checkpoint_save(path);
+}
+
+extern "C" ventus_rtlsim_t* ventus_rtlsim_checkpoint_restore(
+    const char* path, const ventus_rtlsim_config_t* config, void (*finish_callback)(const ventus_kernel_metadata_t*)
+) {
+    ventus_rtlsim_config_t config_default;
+    if (config == nullptr) {
+        ventus_rtlsim_get_default_config(&config_default);
+        config = &config_default;
+    }
+    return ventus_rtlsim_t::checkpoint_restore(path, config, finish_callback);
+}
+
+extern "C" void ventus_kernel_metadata_init(ventus_kernel_metadata_t* metadata) {
+    if (metadata)
+        memset(metadata, 0, sizeof(*metadata));
+}
+
+extern "C" bool ventus_rtlsim_add_kernel__delay_data_loading(
     ventus_rtlsim_t* sim, const ventus_kernel_metadata_t* metadata,
     void (*load_data_callback)(const ventus_kernel_metadata_t*),
     void (*finish_callback)(const ventus_kernel_metadata_t*)
 ) {
+    if (metadata->wg_order > VENTUS_WG_ORDER_TILED) {
+        sim->logger->error(
+            "kernel {} rejected: wg_order {} unrecognized (is the metadata zero-initialized?)",
+            metadata->name ? metadata->name : "unknown_kernel", metadata->wg_order
+        );
+        return false;
+    }
     std::shared_ptr<Kernel> kernel
         = std::make_shared<Kernel>(metadata, load_data_callback, finish_callback, sim->logger);
     sim->cta->kernel_add(kernel);
+    return true;
 }
-extern "C" void ventus_rtlsim_add_kernel(
+extern "C" bool ventus_rtlsim_add_kernel(
     ventus_rtlsim_t* sim, const ventus_kernel_metadata_t* metadata,
     void (*finish_callback)(const ventus_kernel_metadata_t*)
 ) {
-    ventus_rtlsim_add_kernel__delay_data_loading(sim, metadata, nullptr, finish_callback);
+    return ventus_rtlsim_add_kernel__delay_data_loading(sim, metadata, nullptr, finish_callback);
 }
 
 extern "C" bool ventus_rtlsim_pmem_page_alloc(ventus_rtlsim_t* sim, paddr_t base) {
@@ -88,27 +164,59 @@ extern "C" int ventus_rtlsim_get_parameter(const char* name, uint32_t* out_value
 }
 #ifdef ENABLE_GVM
 extern "C" int fw_vt_dev_open() {
-    return gvmref_vt_dev_open();
+    g_gvm_async.drain(); // 异步比对时，REF 须先追上已仿真的 DUT
+    int ret = gvmref_vt_dev_open();
+    g_gvm_trace.hostCall(GVM_TRACE_HOST_DEV_OPEN, ret, {});
+    return ret;
 }
 extern "C" int fw_vt_dev_close() {
-    return gvmref_vt_dev_close();
+    g_gvm_async.drain();
+    int ret = gvmref_vt_dev_close();
+    g_gvm_trace.hostCall(GVM_TRACE_HOST_DEV_CLOSE, ret, {});
+    return ret;
 }
 extern "C" int fw_vt_buf_alloc(uint64_t size, uint64_t *vaddr, int BUF_TYPE, uint64_t taskID, uint64_t kernelID) {
-    return gvmref_vt_buf_alloc(size, vaddr, BUF_TYPE, taskID, kernelID);
+    g_gvm_async.drain();
+    int ret = gvmref_vt_buf_alloc(size, vaddr, BUF_TYPE, taskID, kernelID);
+    g_gvm_trace.hostCall(GVM_TRACE_HOST_BUF_ALLOC, ret, { size, *vaddr, (uint64_t)BUF_TYPE, taskID, kernelID });
+    return ret;
 }
 extern "C" int fw_vt_buf_free(uint64_t size, uint64_t *vaddr, uint64_t taskID, uint64_t kernelID) {
-    return gvmref_vt_buf_free(size, vaddr, taskID, kernelID);
+    g_gvm_async.drain();
+    uint64_t addr = *vaddr;
+    int ret = gvmref_vt_buf_free(size, vaddr, taskID, kernelID);
+    g_gvm_trace.hostCall(GVM_TRACE_HOST_BUF_FREE, ret, { size, addr, taskID, kernelID });
+    return ret;
 }
 extern "C" int fw_vt_one_buf_free(uint64_t size, uint64_t *vaddr, uint64_t taskID, uint64_t kernelID) {
-    return gvmref_vt_one_buf_free(size, vaddr, taskID, kernelID);
+    g_gvm_async.drain();
+    uint64_t addr = *vaddr;
+    int ret = gvmref_vt_one_buf_free(size, vaddr, taskID, kernelID);
+    g_gvm_trace.hostCall(GVM_TRACE_HOST_ONE_BUF_FREE, ret, { size, addr, taskID, kernelID });
+    return ret;
 }
 extern "C" int fw_vt_copy_to_dev(uint64_t dev_vaddr,const void *src_addr, uint64_t size, uint64_t taskID, uint64_t kernelID) {
-    return gvmref_vt_copy_to_dev(dev_vaddr, src_addr, size, taskID, kernelID);
+    g_gvm_async.drain();
+    int ret = gvmref_vt_copy_to_dev(dev_vaddr, src_addr, size, taskID, kernelID);
+    g_gvm_trace.hostCall(GVM_TRACE_HOST_COPY_TO_DEV, ret, { dev_vaddr, size, taskID, kernelID }, src_addr, size);
+    return ret;
 }
 extern "C" int fw_vt_start(void* metaData, uint64_t taskID) {
-    return gvmref_vt_start(metaData, taskID);
+    g_gvm_async.drain();
+    int ret = gvmref_vt_start(metaData, taskID);
+    g_gvm_trace.hostCall(GVM_TRACE_HOST_START, ret, { taskID }, metaData, sizeof(gvmref_meta_data));
+    return ret;
 }
 extern "C" int fw_vt_upload_kernel_file(const char* filename, int taskID) {
-    return gvmref_vt_upload_kernel_file(filename, taskID);
+    g_gvm_async.drain();
+    int ret = gvmref_vt_upload_kernel_file(filename, taskID);
+    if (g_gvm_trace.wantsHostCalls()) {
+        // 连同文件内容一起录制，回放时不依赖原文件
+        std::ifstream file(filename, std::ios::binary);
+        std::vector<char> data(filename, filename + strlen(filename) + 1);
+        data.insert(data.end(), std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        g_gvm_trace.hostCall(GVM_TRACE_HOST_UPLOAD_KERNEL_FILE, ret, { (uint64_t)taskID }, data.data(), data.size());
+    }
+    return ret;
 }
 #endif // ENABLE_GVM
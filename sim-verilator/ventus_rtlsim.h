@@ -18,10 +18,20 @@ extern "C" {
 typedef struct ventus_rtlsim_t ventus_rtlsim_t;
 typedef uint64_t paddr_t;
 
-typedef struct ventus_kernel_metadata_t { // 这个metadata是供驱动使用的，而不是给硬件的
+// 线程块分派顺序（均在x-y平面内变化，最后才变化z）
+typedef enum {
+    VENTUS_WG_ORDER_ROW_MAJOR = 0, // x -> y -> z (default)
+    VENTUS_WG_ORDER_COLUMN_MAJOR,  // y -> x -> z
+    VENTUS_WG_ORDER_MORTON,        // Z-order (Morton) curve in x-y plane
+    VENTUS_WG_ORDER_TILED,         // row-major tiles of wg_order_tile[0] x wg_order_tile[1], row-major inside each tile
+} ventus_wg_order_t;
+
+// 这个metadata是供驱动使用的，而不是给硬件的
+// 须先用ventus_kernel_metadata_init()（或memset为0）初始化再填写，新增字段只追加在末尾，且其0值即原有行为
+typedef struct ventus_kernel_metadata_t {
     // Additional data
-    const char* name; // kernel name
-    void* data;       // use this as you like, such as callback function argument
+    const char* name;          // kernel name
+    void* data;                // use this as you like, such as callback function argument
 
     // Raw metadata
     uint64_t startaddr;
@@ -39,8 +49,24 @@ typedef struct ventus_kernel_metadata_t { // 这个metadata是供驱动使用的
     uint64_t* buffer_base; // 各buffer的基址。第一块buffer是给硬件用的metadata
     uint64_t* buffer_size; // 各buffer的size，以Bytes为单位。实际使用的大小，用于初始化.data
     uint64_t* buffer_allocsize; // 各buffer的size，以Bytes为单位。分配的大小
+
+    // Appended fields, 0 by default
+    uint64_t stream_id;        // 仅config.cta.concurrent_kernel开启时有效：同一stream内的kernel按提交顺序串行执行
+    uint32_t wg_order;         // 线程块分派顺序 ventus_wg_order_t，0为默认的row-major，其他值将被拒绝
+    uint32_t wg_order_tile[2]; // VENTUS_WG_ORDER_TILED的tile大小(x, y)，0视为2
 } ventus_kernel_metadata_t;
 
+// 波形触发条件，满足任一条件即匹配，各项均不设置表示不使用
+// kernel_name/kernel_id/wg_idx须同时满足，在workgroup派发时检查：kernel开始执行以其首个workgroup的派发近似
+typedef struct {
+    const char* kernel_name; // 该kernel的workgroup派发时匹配，NULL不使用
+    int64_t kernel_id;       // 同上，按kernel id，-1不使用
+    int64_t wg_idx;          // kernel内序号为wg_idx的workgroup派发时匹配，-1不使用
+    uint32_t pc;             // 派发该PC的指令时匹配，0不使用。依赖GVM的指令派发DPI（g_insn_dispatch_data），仅GVM构建可用
+    uint64_t addr_base;      // GPU写入物理地址[addr_base, addr_base + addr_size)时匹配
+    uint64_t addr_size;      // 0不使用
+} ventus_waveform_match_t;
+
 typedef struct {
     uint64_t sim_time_max; // 最大仿真时间限制
     struct {               // These log sinks can be enabled simultaneously
@@ -59,6 +85,7 @@ typedef struct {
         uint64_t pagesize; // 物理内存页大小
         uint64_t auto_alloc; // 若访存到未分配的物理页，自动分配（如此则与实际硬件内存行为相同）
         // 注意，自动分配的物理内存是不会释放的，除非整个仿真结束
+        const char* backend; // 物理内存实现: "pagetable"（按页new分配），"mmap"（预留整个4GiB地址空间，按需缺页）
     } pmem;
     struct { // 波形输出功能，这里只设置正常仿真流程，对仿真快照回溯后的波形输出无影响
         bool enable;         // 是否启用？仿真快照回溯后将自动启用
@@ -66,13 +93,80 @@ typedef struct {
         uint64_t time_end;   // 输出波形的结束时刻，end > begin才有波形输出
         int levels;          // 波形输出的层级
         const char* filename;
+        // 滚动波形：>0时波形分段写入rolling_dir（默认/dev/shm，即内存），每隔rolling时间换一段，只保留最近两段，
+        // 仿真出错、$finish、GVM比对出错（任何error日志）、SIGABRT或SIGINT时才写到filename（较早的一段为*.prev.fst），
+        // 正常结束则丢弃。出现error日志后的下一次换段时即写出并停止输出波形
+        // 进程内abort()/assert()时在SIGABRT处理函数中直接移动各段，最后一段未关闭可能不完整（另有*.fst.hier）
+        // 启动时删除rolling_dir中已退出进程遗留的段
+        uint64_t rolling;
+        const char* rolling_dir;
+        // 触发式波形：设置了start条件时，触发前不写出波形，触发后输出[触发时刻 - pre_cycles, 结束时刻)，只触发一次
+        // 结束时刻为触发后首次满足stop条件的时刻与触发时刻 + post_cycles中较早者
+        // 只设置stop条件时从仿真开始输出，满足stop条件即结束（配合rolling则只写出结束前的一段）
+        struct {
+            ventus_waveform_match_t start;
+            ventus_waveform_match_t stop;
+            uint64_t pre_cycles;  // 触发前至少保留多少周期，>0时借助滚动波形（rolling自动设为不小于此值）
+            uint64_t post_cycles; // 触发后最多输出多少周期，0表示不限（有pre_cycles时触发后的波形写到*.post.fst）
+        } trigger;
     } waveform;
     struct { // 仿真快照，当仿真出错时可回溯仿真进度到最旧快照，开启波形记录重新仿真
         bool enable;
         uint64_t time_interval; // 快照时间间隔
-        int num_max;            // 最大快照数量，超限时新快照将顶替最旧快照
+        int num_max;            // 最大快照数量，超限时按retention淘汰一个快照
+        // 快照数超限时淘汰哪个：
+        //   "fifo"  最旧的快照（默认）
+        //   "log"   保持近密远疏，快照间隔随距今时间指数增长：淘汰合并后的间隔与其距今时间之比最小的快照，最新与最旧的保留
+        const char* retention;
+        // 所有快照进程独占的脏页（/proc/PID/smaps_rollup中的Private_Dirty）之和的上限，单位字节，0表示不限
+        // 主进程写入越多，写时复制后快照进程独占的页越多。每次创建快照后检查，超限时按retention淘汰，最新的快照总是保留
+        uint64_t mem_max;
         const char* filename;   // 快照输出的FST波形文件名
+        // 回滚时唤醒哪个快照：
+        //   "oldest"   最旧的快照（默认）
+        //   "nearest"  出错时刻之前最新的快照。出错时刻为bad_time，为0时自动取首条error日志（含GVM比对出错）的时刻
+        //              与仿真结束时刻中较早者
+        //   "bisect"   在各快照（保持冻结，不重新仿真）上调用predicate二分查找其由真变假的区间，只重新仿真该区间并输出波形
+        //              未设置predicate时同"nearest"
+        const char* rollback;
+        uint64_t bad_time;
+        // 判定仿真状态是否仍然正确，在快照进程中对其冻结的状态调用，可用ventus_rtlsim_pmemcpy_d2h()等读取状态，但不可推进仿真
+        bool (*predicate)(ventus_rtlsim_t* sim, void* arg);
+        void* predicate_arg;
     } snapshot;
+    struct { // 记录kernel与线程块的执行时间线，仿真结束时导出为Chrome trace JSON（可用Perfetto UI查看）
+        bool enable;
+        const char* filename;
+        uint64_t capacity; // 最多保留的事件数，超出时丢弃最旧的事件
+    } timeline;
+    struct {
+        // 允许多个kernel同时在GPU上执行：当前kernel的线程块分派完毕后，即可开始分派下一个kernel（需属于不同stream）
+        // 注意：目前没有虚拟内存，需由驱动保证并发kernel的物理内存互不冲突
+        bool concurrent_kernel;
+    } cta;
+    struct { // 仅GVM构建有效
+        // 在独立线程中进行GVM比对：仿真线程将每周期的DUT事件推入队列即继续仿真，仅在队列满时等待
+        // 比对线程的日志时间戳是所处理事件发生时的仿真时间（入队时记录），而非其处理时的仿真时间
+        bool async;
+        uint32_t queue_depth; // 队列最多容纳多少个周期的事件
+        // 录制模式：不在仿真进程中比对，仅将DUT事件与fw_vt_*调用写入该文件，之后用gvm-replay离线比对；NULL表示不录制
+        // 录制时忽略async
+        const char* record_file;
+        // 采样比对规则，NULL表示全部比对。逗号分隔，各条件同时满足的WG才会被比对，例如"every=4,time=1000-90000"
+        //   every=N         只比对software_wg_id为N的倍数的WG
+        //   fraction=F,seed=S  以S为种子随机比对比例为F的WG
+        //   wg=W            比对WG W（可重复）；warp=W.V 比对WG W中的warp V（可重复），同WG的其他warp仅跟踪不比对
+        //   time=B-E        只比对在仿真时间[B,E)内开始的WG，E可省略
+        // 未被比对的WG在DUT中结束后，其REF一次性步进到底，使后续kernel读到的REF内存仍然正确
+        const char* sample;
+        // 首次比对出错时写入的JSON报告，含出错指令的DUT与REF结果、该warp最近history_depth条指令与尚未retire的指令
+        // NULL表示不写入。报告不依赖debug日志，日常仿真可关闭debug日志
+        const char* report_file;
+        uint32_t history_depth; // 每个warp保留的最近指令数
+        // 没有kernel在运行时（即每个kernel结束时，或并发kernel中最后一个结束时），比对DUT写入过的内存页与REF内存
+        // 默认关闭。需要REF提供gvmref_read_mem()，否则自动关闭；录制模式下只录制各页的哈希，由gvm-replay比对
+        bool mem_check;
+    } gvm;
     struct {               // verilator运行时命令行参数，以argc,argv形式传入
         int argc;          // 注意argc可以为0
         const char** argv; // 共有argc个char*字符串，[0]成员不是程序名，而是首个verilator参数
@@ -85,6 +179,21 @@ typedef struct {
     bool idle;        // All given kernels has finished
 } ventus_rtlsim_step_result_t;
 
+// Conditions that make ventus_rtlsim_run() return, used as bit flags in stop_mask
+typedef enum {
+    VENTUS_RTLSIM_STOP_IDLE = 1u << 0,            // All given kernels has finished
+    VENTUS_RTLSIM_STOP_ERROR = 1u << 1,           // Simulation got error (always enabled)
+    VENTUS_RTLSIM_STOP_TIME_EXCEED = 1u << 2,     // Simulation time exceeds limit (always enabled)
+    VENTUS_RTLSIM_STOP_KERNEL_FINISHED = 1u << 3, // A kernel has finished
+    VENTUS_RTLSIM_STOP_WATCH = 1u << 4,           // GPU wrote to the watched physical address range
+} ventus_rtlsim_stop_t;
+
+typedef struct {
+    ventus_rtlsim_step_result_t status; // Same meaning as the return value of ventus_rtlsim_step()
+    uint32_t stop_reason;               // Which ventus_rtlsim_stop_t conditions fired, 0 if max_cycles reached
+    uint64_t cycles;                    // Number of clock cycles simulated in this run
+} ventus_rtlsim_run_result_t;
+
 // =
 // API functions:
 // =
@@ -120,29 +229,67 @@ DLL_PUBLIC void ventus_rtlsim_finish(ventus_rtlsim_t* sim, bool snapshot_rollbac
 // If error occurred, calling this function has no effect, you should consider finish the simulation.
 DLL_PUBLIC const ventus_rtlsim_step_result_t* ventus_rtlsim_step(ventus_rtlsim_t* sim);
 
+// Calculate at most `max_cycles` clock cycles (2 unit-time each) of simulation in a single call.
+// Return early when any condition in `stop_mask` (ventus_rtlsim_stop_t flags) fires.
+// ERROR and TIME_EXCEED always stop the simulation, even if they are not set in stop_mask.
+// This is much faster than calling ventus_rtlsim_step() in a loop. Result is written to *result if not NULL.
+DLL_PUBLIC void ventus_rtlsim_run(
+    ventus_rtlsim_t* sim, uint64_t max_cycles, uint32_t stop_mask, ventus_rtlsim_run_result_t* result
+);
+
+// Watch GPU writes to physical address range [base, base+size), used by VENTUS_RTLSIM_STOP_WATCH
+// size = 0 disables the watch
+DLL_PUBLIC void ventus_rtlsim_set_watch(ventus_rtlsim_t* sim, paddr_t base, uint64_t size);
+
 // Host request GPGPU device to invalidate its Icache
 // (for example, after loading new kernel code to device memory)
 // This will take effect in the next simulation step()
 DLL_PUBLIC void ventus_rtlsim_icache_invalidate(ventus_rtlsim_t* sim);
 
+//
+// Checkpoint: save the whole simulation state to a file, and restore it later in another process
+//   so that many experiments can start from a warmed-up state instead of reset.
+// Only available when libVentusRTL is built with `make -f verilate.mk SAVABLE=1`, and not in GVM builds
+//   (the REF state cannot be saved). Otherwise save returns false and restore returns NULL.
+//
+
+// Save the state between two steps. Return false on failure, for example when a kernel added by
+//   ventus_rtlsim_add_kernel__delay_data_loading() has not been activated yet (the callback cannot be saved).
+DLL_PUBLIC bool ventus_rtlsim_checkpoint_save(ventus_rtlsim_t* sim, const char* path);
+
+// Create a simulation from the checkpoint. Return NULL on failure.
+// config: used for logging, waveform, snapshot, etc. (NULL for default config),
+//   while pmem and cta settings are taken from the checkpoint.
+// Callbacks and metadata->data of kernels cannot be saved: every restored kernel calls `finish_callback`
+//   (may be NULL) with a metadata copy owned by the simulation, whose `data` is NULL.
+DLL_PUBLIC ventus_rtlsim_t* ventus_rtlsim_checkpoint_restore(
+    const char* path, const ventus_rtlsim_config_t* config, void (*finish_callback)(const ventus_kernel_metadata_t*)
+);
+
 //
 // Push new kernels to gpu for execution.
 //
 
+// Zero all fields of *metadata, including fields appended in later versions. Call this before filling in a metadata,
+//   so that fields unknown to the driver keep their default behavior.
+DLL_PUBLIC void ventus_kernel_metadata_init(ventus_kernel_metadata_t* metadata);
+
 // After a kernel finishing its execution, the finish_callback will be called, with metadata passed,
 //   aka. `finish_callback(metadata)` will be called.
 
+// Return false if the metadata is invalid (e.g. unknown wg_order), the kernel is not added then.
+
 // It's allowed to delay data-loading until the kernel is actually activated on GPU,
 // by using data_load_callback
 // **Temporary api**, May be removed in the future
-DLL_PUBLIC void ventus_rtlsim_add_kernel__delay_data_loading(
+DLL_PUBLIC bool ventus_rtlsim_add_kernel__delay_data_loading(
     ventus_rtlsim_t* sim, const ventus_kernel_metadata_t* metadata,
     void (*load_data_callback)(const ventus_kernel_metadata_t*),
     void (*finish_callback)(const ventus_kernel_metadata_t*)
 );
 
 // It's recommended to use this ↓. Remember to load data to GPU before calling this.
-DLL_PUBLIC void ventus_rtlsim_add_kernel(
+DLL_PUBLIC bool ventus_rtlsim_add_kernel(
     ventus_rtlsim_t* sim, const ventus_kernel_metadata_t* metadata,
     void (*finish_callback)(const ventus_kernel_metadata_t*)
 );
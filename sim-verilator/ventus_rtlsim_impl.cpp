@@ -3,26 +3,46 @@
 #include "ventus_rtlsim.h"
 #include "verilated.h"
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
 #include <csignal>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
 #include <fmt/core.h>
+#include <fstream>
 #include <functional>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <spdlog/common.h>
 #include <spdlog/formatter.h>
+#include <spdlog/sinks/base_sink.h>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <string>
 #include <sys/prctl.h>
 #include <sys/wait.h>
+#include <unistd.h>
 #include <utility>
+#ifdef VENTUS_RTLSIM_SAVABLE
+#include <verilated_save.h>
+#endif // VENTUS_RTLSIM_SAVABLE
 
 #include "gvm.hpp"
+#ifdef ENABLE_GVM
+#include "gvm_async.hpp"
+#include "gvm_dpic.hpp"
+#include "gvm_trace.hpp"
+#endif // ENABLE_GVM
 
 constexpr uint64_t HALF_CYCLE_TIME = 5;
+constexpr uint64_t LOG_TIME_INTERVAL = 10000; // 每隔多少仿真时间输出一次时钟日志
 
 //
 // cleanup at exit
@@ -35,8 +55,9 @@ static std::vector<ventus_rtlsim_t*> g_instances;
 //  in this case, a .fst.hier file appears. 
 static void cleanup() {
     for (auto* sim : g_instances) {
-        if (sim->tfp)
+        if (sim->tfp && sim->tfp->isOpen())
             sim->tfp->close(); // save waveform to file
+        sim->waveform_ring_finish(true); // exiting without destroying the simulation, keep the rolling waveform
         // No need to delete tfp, the process is exiting
         // delete sim->tfp; // This will cause segfault sometimes, why?
         sim->tfp = nullptr;
@@ -58,7 +79,43 @@ static volatile std::sig_atomic_t g_interrupt = false;
 static volatile std::sig_atomic_t g_aborted = false;
 static std::optional<struct sigaction> g_sigabort_old = std::nullopt;
 void signal_interrupt_handler(int signum) { g_interrupt = true; }
-void signal_abort_handler(int signum) { g_aborted = true; }
+
+// 在信号处理函数中移动文件，只用async-signal-safe的系统调用。/dev/shm与logs/不在同一文件系统时rename失败，改为复制
+static void move_file_in_signal(const char* from, const char* to) {
+    if (from[0] == '\0' || rename(from, to) == 0)
+        return;
+    int in = open(from, O_RDONLY);
+    if (in < 0)
+        return;
+    int out = open(to, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out >= 0) {
+        char buf[65536];
+        ssize_t n;
+        while ((n = read(in, buf, sizeof(buf))) > 0 && write(out, buf, n) == n) { }
+        close(out);
+    }
+    close(in);
+    unlink(from);
+}
+
+// 外部发来的SIGABRT：回到仿真循环后由handle_signals()正常结束
+// 本进程的abort()/assert()（含GVM比对线程）：处理函数返回后进程即以默认方式终止，atexit与handle_signals()都不会执行，
+//   只能在这里保存滚动波形。最后一段未关闭，可能不完整（层次信息在*.fst.hier中），较早的一段是完整的
+void signal_abort_handler(int signum, siginfo_t* info, void* ucontext) {
+    g_aborted = true;
+    if (info == nullptr || info->si_pid != getpid())
+        return;
+    for (size_t i = 0; i < g_instances.size(); i++) {
+        auto& ring = g_instances[i]->waveform_ring;
+        if (!ring.abort_ready)
+            continue;
+        ring.abort_ready = false;
+        for (int j = 2; j >= 0; j--) // previous first
+            move_file_in_signal(ring.abort_src[j], ring.abort_dst[j]);
+        const char msg[] = "Rolling waveform saved on abort\n";
+        write(STDERR_FILENO, msg, sizeof(msg) - 1);
+    }
+}
 
 //
 // Helpers
@@ -109,6 +166,89 @@ private:
     std::function<std::string()> m_callback;
 };
 
+// 记录首条error及以上级别日志的仿真时间，供snapshot rollback确定出错时刻
+// GVM比对线程也会写日志，first_error_time由仿真线程读取
+class FirstErrorSink_ventus_rtlsim : public spdlog::sinks::base_sink<std::mutex> {
+public:
+    FirstErrorSink_ventus_rtlsim(std::function<uint64_t()> get_time, std::atomic<uint64_t>& first_error_time)
+        : m_get_time(get_time)
+        , m_first_error_time(first_error_time) {
+        set_level(spdlog::level::err);
+    }
+
+protected:
+    void sink_it_(const spdlog::details::log_msg& msg) override {
+        // 比对线程的日志可能晚于仿真线程写出，取最早的时间；base_sink已加锁，只有这里写入
+        uint64_t time = m_get_time();
+        if (time < m_first_error_time.load(std::memory_order_relaxed))
+            m_first_error_time.store(time, std::memory_order_relaxed);
+    }
+    void flush_() override {}
+
+private:
+    std::function<uint64_t()> m_get_time;
+    std::atomic<uint64_t>& m_first_error_time;
+};
+
+// 删除已退出进程（被SIGKILL等）遗留在rolling_dir中的波形段 ventus_rtlsim.<pid>.<seq>.fst[.hier]
+static void waveform_ring_sweep_stale(const char* dir) {
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+        std::string name = it->path().filename().string();
+        if (!name.starts_with("ventus_rtlsim.") || !(name.ends_with(".fst") || name.ends_with(".fst.hier")))
+            continue;
+        char* pid_end = nullptr;
+        long pid = strtol(name.c_str() + strlen("ventus_rtlsim."), &pid_end, 10);
+        if (pid <= 0 || *pid_end != '.' || pid == getpid())
+            continue;
+        if (kill(pid, 0) != 0 && errno == ESRCH) {
+            std::error_code ec_remove;
+            std::filesystem::remove(it->path(), ec_remove);
+        }
+    }
+}
+
+// 波形触发条件是否设置了任一项
+static bool waveform_match_enabled(const ventus_waveform_match_t& match) {
+    return match.kernel_name || match.kernel_id >= 0 || match.wg_idx >= 0 || match.pc || match.addr_size;
+}
+
+// workgroup派发是否满足波形触发条件中kernel_name/kernel_id/wg_idx的部分
+static bool waveform_match_dispatch(
+    const ventus_waveform_match_t& match, const std::string& kernel_name, uint32_t kernel_id, uint32_t wg_idx
+) {
+    return (match.kernel_name || match.kernel_id >= 0 || match.wg_idx >= 0)
+        && (!match.kernel_name || kernel_name == match.kernel_name)
+        && (match.kernel_id < 0 || kernel_id == match.kernel_id) && (match.wg_idx < 0 || wg_idx == match.wg_idx);
+}
+
+// 将time向上对齐到interval的整数倍，interval为0表示禁用
+static uint64_t time_next_aligned(uint64_t time, uint64_t interval) {
+    if (interval == 0)
+        return UINT64_MAX;
+    return (time / interval + 1) * interval;
+}
+
+// 带字节掩码的写入是否落在[base, base + range)内
+static bool masked_write_overlaps(
+    paddr_t addr, const uint32_t* packed_mask, uint64_t size, paddr_t base, uint64_t range
+) {
+    paddr_t begin = std::max<paddr_t>(addr, base);
+    paddr_t end = std::min<paddr_t>(addr + size, base + range);
+    for (paddr_t i = begin; i < end; i++) {
+        if ((packed_mask[(i - addr) / 32] >> ((i - addr) % 32)) & 0x1) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool waveform_match_write(
+    const ventus_waveform_match_t& match, paddr_t addr, const uint32_t* packed_mask, uint64_t size
+) {
+    return match.addr_size != 0 && masked_write_overlaps(addr, packed_mask, size, match.addr_base, match.addr_size);
+}
+
 //
 // RTLSIM implementation
 //
@@ -129,8 +269,55 @@ void ventus_rtlsim_t::constructor(const ventus_rtlsim_config_t* config_) {
                   << std::endl;
         config.snapshot.filename = "logs/ventus_rtlsim.snapshot.fst";
     }
+    if (!config.waveform.enable) {
+        config.waveform.rolling = 0;
+    } else {
+        auto& trigger = config.waveform.trigger;
+#ifndef ENABLE_GVM
+        if (trigger.start.pc || trigger.stop.pc) {
+            std::cerr << "waveform trigger on PC needs a GVM build, ignored" << std::endl;
+            trigger.start.pc = 0;
+            trigger.stop.pc = 0;
+        }
+#endif // ENABLE_GVM
+        waveform_trigger_armed = waveform_match_enabled(trigger.start);
+        waveform_stop_armed = !waveform_trigger_armed && waveform_match_enabled(trigger.stop);
+        if (waveform_trigger_armed && trigger.pre_cycles) {
+            config.waveform.rolling = std::max(config.waveform.rolling, trigger.pre_cycles * 2 * HALF_CYCLE_TIME);
+        }
+    }
+    if (config.waveform.rolling && config.waveform.rolling_dir == NULL) {
+        config.waveform.rolling_dir = "/dev/shm";
+    }
+    if (config.timeline.enable && config.timeline.filename == NULL) {
+        std::cerr << "timeline enabled but filename is NULL, set to default: logs/ventus_rtlsim.trace.json"
+                  << std::endl;
+        config.timeline.filename = "logs/ventus_rtlsim.trace.json";
+    }
     config.verilator.argc = 0;
     config.verilator.argv = nullptr;
+    if (config.snapshot.retention == nullptr) {
+        config.snapshot.retention = "fifo";
+    } else if (strcmp(config.snapshot.retention, "fifo") != 0 && strcmp(config.snapshot.retention, "log") != 0) {
+        std::cerr << "Snapshot retention policy unrecognized: \"" << config.snapshot.retention
+                  << "\", set to default: \"fifo\"" << std::endl;
+        config.snapshot.retention = "fifo";
+    }
+    if (config.snapshot.rollback == nullptr) {
+        config.snapshot.rollback = "oldest";
+    } else if (strcmp(config.snapshot.rollback, "oldest") != 0 && strcmp(config.snapshot.rollback, "nearest") != 0
+               && strcmp(config.snapshot.rollback, "bisect") != 0) {
+        std::cerr << "Snapshot rollback policy unrecognized: \"" << config.snapshot.rollback
+                  << "\", set to default: \"oldest\"" << std::endl;
+        config.snapshot.rollback = "oldest";
+    }
+    PhysicalMemory::backend_t pmem_backend = PhysicalMemory::BACKEND_PAGETABLE;
+    if (config.pmem.backend != nullptr && strcmp(config.pmem.backend, "mmap") == 0) {
+        pmem_backend = PhysicalMemory::BACKEND_MMAP;
+    } else if (config.pmem.backend != nullptr && strcmp(config.pmem.backend, "pagetable") != 0) {
+        std::cerr << "PMEM backend unrecognized: \"" << config.pmem.backend << "\", set to default: \"pagetable\""
+                  << std::endl;
+    }
 
     // init logger
     try {
@@ -145,6 +332,10 @@ void ventus_rtlsim_t::constructor(const ventus_rtlsim_config_t* config_) {
             console_sink->set_level(get_log_level(config.log.console.level));
             sinks.push_back(console_sink);
         }
+        first_error_time = UINT64_MAX;
+        sinks.push_back(std::make_shared<FirstErrorSink_ventus_rtlsim>(
+            [this]() -> uint64_t { return log_time(); }, first_error_time
+        ));
         logger = std::make_shared<spdlog::logger>("VentusRTLsim_logger", sinks.begin(), sinks.end());
 #ifdef ENABLE_GVM
         gvm.logger = logger;
@@ -153,8 +344,7 @@ void ventus_rtlsim_t::constructor(const ventus_rtlsim_config_t* config_) {
         logger->flush_on(spdlog::level::err);
 
         // set logger formatter
-        auto func_log_prefix
-            = [&contextp = std::as_const(contextp)]() -> std::string { return fmt::format("@{} ", contextp->time()); };
+        auto func_log_prefix = [this]() -> std::string { return fmt::format("@{} ", log_time()); };
         auto formatter = std::make_unique<Formatter_ventus_rtlsim>(func_log_prefix);
         logger->set_formatter(std::move(formatter));
 
@@ -175,7 +365,8 @@ void ventus_rtlsim_t::constructor(const ventus_rtlsim_config_t* config_) {
     contextp->randReset(0);
     contextp->traceEverOn(true);
     snapshots.is_child = false;
-    snapshots.children_pid.clear();
+    snapshots.children.clear();
+    snapshots.trace_end_time = UINT64_MAX;
 
     // load Verilator runtime arguments
     const char* verilator_runtime_args_default[] = { "+verilator+seed+10086" };
@@ -188,25 +379,35 @@ void ventus_rtlsim_t::constructor(const ventus_rtlsim_config_t* config_) {
 
     // instantiate hardware
     dut = new Vdut();
-    cta = new Cta(logger);
-    pmem = std::make_unique<PhysicalMemory>(config.pmem.auto_alloc, config.pmem.pagesize, logger);
+    cta = new Cta(logger, config.cta.concurrent_kernel, [this]() -> uint64_t { return contextp->time(); });
+    pmem = std::make_unique<PhysicalMemory>(config.pmem.auto_alloc, config.pmem.pagesize, logger, pmem_backend);
     need_icache_invalidate = false;
+    if (config.timeline.enable) {
+        timeline = std::make_unique<Timeline>(config.timeline.capacity, logger);
+        cta->set_timeline(timeline.get());
+    }
 
     // waveform traces (FST)
     if (config.waveform.enable) {
         tfp = new VerilatedFstC;
         dut->trace(tfp, config.waveform.levels);
-        tfp->open(config.waveform.filename);
+        if (config.waveform.rolling) {
+            waveform_ring_sweep_stale(config.waveform.rolling_dir);
+            waveform_roll();
+        } else if (!waveform_trigger_armed) { // 触发式波形在触发时才创建文件
+            tfp->open(config.waveform.filename);
+        }
         // sig abort
         struct sigaction sa;
-        sa.sa_handler = signal_abort_handler;
-        sa.sa_flags = 0;
+        sa.sa_sigaction = signal_abort_handler;
+        sa.sa_flags = SA_SIGINFO;
         sigemptyset(&sa.sa_mask);
         struct sigaction sa_old;
         sigaction(SIGABRT, &sa, &sa_old);
         g_sigabort_old = sa_old;
         // sig interrupt
         sa.sa_handler = signal_interrupt_handler;
+        sa.sa_flags = 0;
         sigaction(SIGINT, &sa, nullptr);
     } else {
         tfp = nullptr;
@@ -215,18 +416,122 @@ void ventus_rtlsim_t::constructor(const ventus_rtlsim_config_t* config_) {
     // push into global instances, prepare cleanup at exit
     g_instances.push_back(this);
 
+#ifdef ENABLE_GVM
+    if (config.gvm.sample) {
+        std::string err;
+        if (gvm.sample.parse(config.gvm.sample, err)) {
+            logger->info("GVM: sampling enabled, rules: {}", config.gvm.sample);
+        } else {
+            logger->error("GVM: {}, checking all workgroups", err);
+            gvm.sample = gvm_sample_t();
+        }
+    }
+    gvm.history_depth = config.gvm.history_depth;
+    gvm.report_file = config.gvm.report_file ? config.gvm.report_file : "";
+    if (!g_gvm_trace.open(config.gvm.record_file)) {
+        logger->error("GVM: cannot open trace file {} for recording", config.gvm.record_file);
+    } else if (config.gvm.record_file) {
+        logger->info("GVM: recording trace to {}, check it with gvm-replay", config.gvm.record_file);
+    } else if (config.gvm.async) {
+        g_gvm_async.start(&gvm, config.gvm.queue_depth);
+        logger->info("GVM: async checking enabled, queue depth {}", config.gvm.queue_depth);
+    }
+    if (config.gvm.mem_check && !config.gvm.record_file && gvmref_read_mem == nullptr) {
+        // 无法比对时也不必在每个kernel结束时对脏页求哈希
+        logger->warn("GVM: REF does not provide gvmref_read_mem(), gvm.mem_check disabled");
+        config.gvm.mem_check = false;
+    }
+#endif // ENABLE_GVM
+
     // get ready to run
     snapshot_fork(); // initial snapshot at sim_time = 0
     dut_reset();
+    log_time_next = time_next_aligned(contextp->time(), LOG_TIME_INTERVAL);
+    snapshot_time_next
+        = time_next_aligned(contextp->time(), config.snapshot.enable ? config.snapshot.time_interval : 0);
+    waveform_roll_time_next = time_next_aligned(contextp->time(), config.waveform.rolling);
+    housekeeping_time_next = std::min({ log_time_next, snapshot_time_next, waveform_roll_time_next });
 }
 
 const ventus_rtlsim_step_result_t* ventus_rtlsim_t::step() {
-    step_status.error = contextp->gotFinish() || contextp->gotError();
-    step_status.time_exceed = contextp->time() >= config.sim_time_max;
-    step_status.idle = cta->is_idle();
+    update_step_status(false);
     if (step_status.error || step_status.time_exceed) {
         return &step_status;
     }
+
+    bool sim_got_error = !half_cycle();
+    if (g_interrupt || g_aborted) {
+        handle_signals();
+    }
+    update_step_status(sim_got_error);
+    if (contextp->time() >= housekeeping_time_next) {
+        housekeeping();
+    }
+    return &step_status;
+}
+
+void ventus_rtlsim_t::run(uint64_t max_cycles, uint32_t stop_mask, ventus_rtlsim_run_result_t* result) {
+    // ERROR and TIME_EXCEED always stop the simulation
+    stop_mask |= VENTUS_RTLSIM_STOP_ERROR | VENTUS_RTLSIM_STOP_TIME_EXCEED;
+    result->stop_reason = 0;
+    result->cycles = 0;
+
+    update_step_status(false);
+    if (step_status.error || step_status.time_exceed) {
+        result->stop_reason |= step_status.error ? VENTUS_RTLSIM_STOP_ERROR : 0;
+        result->stop_reason |= step_status.time_exceed ? VENTUS_RTLSIM_STOP_TIME_EXCEED : 0;
+        result->status = step_status;
+        return;
+    }
+
+    const uint64_t half_cycles_max = max_cycles > UINT64_MAX / 2 ? UINT64_MAX : max_cycles * 2;
+    const uint64_t num_kernel_finished = cta->get_num_kernel_finished();
+    uint64_t half_cycles = 0;
+    uint32_t stop_reason = 0;
+    bool sim_got_error = false;
+    watch.hit = false;
+
+    // 紧凑的仿真循环：每半个时钟周期只检查必要的停止条件，其余杂项由housekeeping按截止时间处理
+    while (half_cycles < half_cycles_max) {
+        sim_got_error = !half_cycle();
+        half_cycles++;
+        if (g_interrupt || g_aborted) {
+            handle_signals();
+        }
+
+        uint64_t time = contextp->time();
+        if (sim_got_error || contextp->gotFinish() || contextp->gotError()) {
+            stop_reason |= VENTUS_RTLSIM_STOP_ERROR;
+        }
+        if (time >= config.sim_time_max) {
+            stop_reason |= VENTUS_RTLSIM_STOP_TIME_EXCEED;
+        }
+        if ((stop_mask & VENTUS_RTLSIM_STOP_IDLE) && cta->is_idle()) {
+            stop_reason |= VENTUS_RTLSIM_STOP_IDLE;
+        }
+        if ((stop_mask & VENTUS_RTLSIM_STOP_KERNEL_FINISHED)
+            && cta->get_num_kernel_finished() != num_kernel_finished) {
+            stop_reason |= VENTUS_RTLSIM_STOP_KERNEL_FINISHED;
+        }
+        if ((stop_mask & VENTUS_RTLSIM_STOP_WATCH) && watch.hit) {
+            stop_reason |= VENTUS_RTLSIM_STOP_WATCH;
+        }
+        if (time >= housekeeping_time_next) {
+            update_step_status(sim_got_error);
+            housekeeping();
+        }
+        if (stop_reason & stop_mask) {
+            break;
+        }
+    }
+
+    update_step_status(sim_got_error);
+    result->status = step_status;
+    result->stop_reason = stop_reason & stop_mask;
+    result->cycles = (half_cycles + 1) / 2; // 不完整的周期也计为1个
+}
+
+bool ventus_rtlsim_t::half_cycle() {
     bool sim_got_error = false;
 
     //
@@ -259,18 +564,21 @@ const ventus_rtlsim_step_result_t* ventus_rtlsim_t::step() {
         // Physical memory access - write
         if (dut->io_mem_wr_en) {
             uint64_t wr_addr = dut->io_mem_wr_addr;
-            bool* mask = new bool[dut->io_mem_wr_mask.Words * 32];
-            for (int idx = 0; idx < dut->io_mem_wr_mask.Words; idx++) {
-                uint32_t mask_raw = dut->io_mem_wr_mask[idx];
-                for (int bit = 0; bit < 32; bit++) {
-                    mask[bit + idx * 32] = mask_raw & 0x1;
-                    mask_raw >>= 1;
-                }
-            }
-            if (!pmem->write(wr_addr, dut->io_mem_wr_data.data(), mask, dut->io_mem_wr_data.Words * 4)) {
+            const uint32_t* mask = dut->io_mem_wr_mask.data();
+            uint64_t size = dut->io_mem_wr_data.Words * 4;
+            static_assert(decltype(dut->io_mem_wr_mask)::Words * 32 >= decltype(dut->io_mem_wr_data)::Words * 4);
+            if (!pmem->write_masked(wr_addr, dut->io_mem_wr_data.data(), mask, size)) {
                 sim_got_error = true;
             }
-            delete[] mask;
+            if (watch.size != 0 && masked_write_overlaps(wr_addr, mask, size, watch.base, watch.size)) {
+                watch.hit = true;
+            }
+            const auto& trigger = config.waveform.trigger;
+            if (waveform_trigger_armed && waveform_match_write(trigger.start, wr_addr, mask, size)) {
+                waveform_trigger_fire(fmt::format("write to 0x{:08x}", wr_addr));
+            } else if (waveform_stop_armed && waveform_match_write(trigger.stop, wr_addr, mask, size)) {
+                waveform_trigger_stop(fmt::format("write to 0x{:08x}", wr_addr));
+            }
         }
     }
 
@@ -284,16 +592,31 @@ const ventus_rtlsim_step_result_t* ventus_rtlsim_t::step() {
             uint32_t wg_id = dut->io_host_req_bits_host_wg_id;
             uint32_t wg_idx, kernel_id;
             std::string kernel_name;
-            assert(cta->wg_get_info(kernel_name, kernel_id, wg_idx));
+            bool wg_valid = cta->wg_get_info(kernel_name, kernel_id, wg_idx);
+            assert(wg_valid);
             cta->wg_dispatched();
             logger->debug(fmt::format(
                 "block{0:<2} dispatched to GPU (kernel{1:<2} {2} block{3:<2})", wg_id, kernel_id, kernel_name, wg_idx
             ));
+            const auto& trigger = config.waveform.trigger;
+            auto reason = [&]() {
+                return fmt::format("dispatch of kernel{} {} block{}", kernel_id, kernel_name, wg_idx);
+            };
+            if (waveform_trigger_armed && waveform_match_dispatch(trigger.start, kernel_name, kernel_id, wg_idx)) {
+                waveform_trigger_fire(reason());
+            } else if (waveform_stop_armed && waveform_match_dispatch(trigger.stop, kernel_name, kernel_id, wg_idx)) {
+                waveform_trigger_stop(reason());
+            }
         }
         // Thread-block return from GPU (handshake OK)
         if (dut->io_host_rsp_valid && dut->io_host_rsp_ready) {
             uint32_t wg_id = dut->io_host_rsp_bits_inflight_wg_buffer_host_wf_done_wg_id;
             cta->wg_finish(wg_id);
+#ifdef ENABLE_GVM
+            if (config.gvm.mem_check && cta->get_num_kernel_active() == 0) {
+                gvm_mem_check();
+            }
+#endif // ENABLE_GVM
         }
         dut->io_icache_invalidate = need_icache_invalidate;
         need_icache_invalidate = false;
@@ -305,9 +628,96 @@ const ventus_rtlsim_step_result_t* ventus_rtlsim_t::step() {
     dut->eval();
     waveform_dump();
 
-    //
-    // Abort?
-    //
+#ifdef ENABLE_GVM
+    if (contextp->time() % 2 == 1) {
+        const auto& trigger = config.waveform.trigger;
+        if ((waveform_trigger_armed && trigger.start.pc) || (waveform_stop_armed && trigger.stop.pc)) {
+            for (const auto& item : g_insn_dispatch_data) {
+                auto reason = [&]() { return fmt::format("dispatch of PC 0x{:08x} on sm{}", item.pc, item.sm_id); };
+                if (waveform_trigger_armed && item.pc == trigger.start.pc) {
+                    waveform_trigger_fire(reason());
+                    break;
+                } else if (waveform_stop_armed && item.pc == trigger.stop.pc) {
+                    waveform_trigger_stop(reason());
+                    break;
+                }
+            }
+        }
+        if (timeline) {
+            for (const auto& item : g_cta2warp_data) {
+                if (item.software_warp_id == 0)
+                    timeline->wg_on_sm(contextp->time(), item.software_wg_id, item.sm_id);
+            }
+        }
+        if (config.gvm.record_file) {
+            // 录制模式：只写轨迹，不比对；快照子进程回滚后不再录制，事件直接丢弃
+            gvm_dut_events_take(gvm.dut_events, contextp->time());
+            if (!gvm.dut_events.empty() && g_gvm_trace.recording()) {
+                gvm_dut_events_capture_xregs(gvm.dut_events);
+                g_gvm_trace.cycle(gvm.dut_events);
+            }
+            gvm.dut_events.clear();
+        } else if (g_gvm_async.running()) {
+            g_gvm_async.push(contextp->time());
+        } else {
+            gvm_dut_events_take(gvm.dut_events, contextp->time());
+            gvm.getDut();
+            gvm.gvmStep();
+        }
+    }
+#endif // ENABLE_GVM
+
+    return !sim_got_error;
+}
+
+#ifdef ENABLE_GVM
+void ventus_rtlsim_t::gvm_mem_check() {
+    // 检查自上次比对以来写入过的页（包括host写入，其内容同样经fw_vt_copy_to_dev写入了REF）
+    const uint64_t pagesize = pmem->get_pagesize();
+    std::vector<gvm_mem_page_t> pages;
+    pages.reserve(pmem->dirty_pages().size());
+    for (paddr_t base : pmem->dirty_pages()) {
+        const uint8_t* data = pmem->page_data(base);
+        if (data != nullptr) { // 已释放的页不比对
+            pages.push_back({ base, gvm_t::memHash(data, pagesize), data });
+        }
+    }
+    pmem->dirty_clear();
+    if (config.gvm.record_file) {
+        if (g_gvm_trace.recording()) {
+            std::vector<uint64_t> hashes; // base, hash, ...
+            for (const auto& page : pages) {
+                hashes.push_back(page.base);
+                hashes.push_back(page.hash);
+            }
+            g_gvm_trace.hostCall(
+                GVM_TRACE_MEM_CHECK, 0, { pagesize, pages.size() }, hashes.data(), hashes.size() * sizeof(uint64_t)
+            );
+        }
+        return;
+    }
+    g_gvm_async.drain(); // 异步比对时，REF 须先追上已仿真的 DUT
+    gvm.checkMem(pages, pagesize);
+}
+#endif // ENABLE_GVM
+
+uint64_t ventus_rtlsim_t::log_time() const {
+#ifdef ENABLE_GVM
+    // 比对线程不能读contextp->time()：仿真线程正在推进它，且此时已晚于事件发生的周期
+    uint64_t event_time = gvm_async_t::eventTime();
+    if (event_time != UINT64_MAX)
+        return event_time;
+#endif // ENABLE_GVM
+    return contextp ? contextp->time() : 0;
+}
+
+void ventus_rtlsim_t::update_step_status(bool sim_got_error) {
+    step_status.error = sim_got_error || contextp->gotFinish() || contextp->gotError();
+    step_status.time_exceed = contextp->time() >= config.sim_time_max;
+    step_status.idle = cta->is_idle();
+}
+
+void ventus_rtlsim_t::handle_signals() {
     if (g_interrupt) {
         destructor(false);
         std::exit(130);
@@ -322,35 +732,61 @@ const ventus_rtlsim_step_result_t* ventus_rtlsim_t::step() {
             std::exit(EXIT_FAILURE);
         }
     }
+}
+
+// 低频杂项（时钟日志、snapshot fork），仅在到达截止时间时调用，避免每个step做取模运算
+// 调用前需更新step_status
+void ventus_rtlsim_t::housekeeping() {
+    uint64_t time = contextp->time();
 
     //
     // Clock output
     //
-    if (contextp->time() % 10000 == 0) {
+    if (time >= log_time_next) {
         logger->debug("");
+        log_time_next = time_next_aligned(time, LOG_TIME_INTERVAL);
     }
 
     //
     // snapshot fork
     //
-    step_status.error = sim_got_error || contextp->gotFinish() || contextp->gotError();
-    step_status.time_exceed = contextp->time() >= config.sim_time_max;
-    step_status.idle = cta->is_idle();
-    if (!step_status.time_exceed && !step_status.error && contextp->time() % config.snapshot.time_interval == 0) {
-        snapshot_fork();
+    if (time >= snapshot_time_next) {
+        if (!step_status.time_exceed && !step_status.error) {
+            snapshot_fork();
+        }
+        snapshot_time_next = time_next_aligned(time, config.snapshot.enable ? config.snapshot.time_interval : 0);
     }
 
+    //
+    // rolling waveform
+    //
+    if (time >= waveform_roll_time_next) {
 #ifdef ENABLE_GVM
-    if (contextp->time() % 2 == 1) {
-        gvm.getDut();
-        gvm.gvmStep();
-    }
+        g_gvm_async.drain(); // 异步比对时，须先比对完已仿真的DUT事件，才能确定是否出错
 #endif // ENABLE_GVM
+        if (first_error_time != UINT64_MAX || waveform_trigger_time != UINT64_MAX || waveform_stop_time != UINT64_MAX) {
+            // 出错、触发后的post_cycles结束或满足stop条件：不再换段，写出已有波形并停止输出
+            logger->info("Waveform dump stopped");
+            if (tfp->isOpen())
+                tfp->close();
+            waveform_ring_finish(true);
+            config.waveform.time_end = time;
+            waveform_roll_time_next = UINT64_MAX;
+            waveform_stop_armed = false;
+        } else {
+            waveform_roll();
+            waveform_roll_time_next = time_next_aligned(time, config.waveform.rolling);
+        }
+    }
 
-    return &step_status;
+    housekeeping_time_next = std::min({ log_time_next, snapshot_time_next, waveform_roll_time_next });
 }
 
 void ventus_rtlsim_t::destructor(bool snapshot_rollback_forcing) {
+#ifdef ENABLE_GVM
+    g_gvm_async.stop(); // 处理完所有已入队的 GVM 事件
+    g_gvm_trace.close();
+#endif // ENABLE_GVM
     uint64_t sim_end_time = contextp->time();
     bool need_rollback
         = snapshot_rollback_forcing || step_status.error || contextp->gotError() || contextp->gotFinish();
@@ -379,13 +815,20 @@ void ventus_rtlsim_t::destructor(bool snapshot_rollback_forcing) {
         }
     }
 
-    if (tfp)
+    if (timeline && !snapshots.is_child) {
+        timeline->dump(config.timeline.filename, sim_end_time);
+    }
+    if (tfp && tfp->isOpen())
         tfp->close();
+    waveform_ring_finish(
+        need_rollback || g_aborted || g_interrupt || first_error_time != UINT64_MAX
+        || waveform_trigger_time != UINT64_MAX || waveform_stop_time != UINT64_MAX
+    );
     dut->final();                  // Final model cleanup
     contextp->statsPrintSummary(); // Final simulation summary
 
     // invoke snapshot if needed
-    if (config.snapshot.enable && !snapshots.is_child && snapshots.children_pid.size() != 0 && need_rollback) {
+    if (config.snapshot.enable && !snapshots.is_child && snapshots.children.size() != 0 && need_rollback) {
         snapshot_rollback(sim_end_time); // Exec snapshot
     }
     // clear snapshots
@@ -412,28 +855,48 @@ void ventus_rtlsim_t::snapshot_fork() {
         return;
     assert(dut && contextp);
 
-    // delete oldest snapshot if needed
-    if (snapshots.children_pid.size() >= config.snapshot.num_max) {
-        pid_t oldest = snapshots.children_pid.back();
-        kill(oldest, SIGKILL);
-        waitpid(oldest, NULL, 0);
-        snapshots.children_pid.pop_back();
+    // delete snapshots if needed
+    while (!snapshots.children.empty() && snapshots.children.size() >= config.snapshot.num_max) {
+        snapshot_evict(snapshot_choose_victim());
     }
     // fork a new snapshot process
     // see https://verilator.org/guide/latest/connecting.html#process-level-clone-apis
     // see verilator/test_regress/t/t_wrapper_clone.cpp:48
+#ifdef ENABLE_GVM
+    g_gvm_async.drain(); // GVM 比对线程须处于空闲等待，fork 时不能持有任何锁
+#endif // ENABLE_GVM
+    // Block snapshot signals before fork, or a rollback right after fork may kill the child before it waits
+    sigset_t set, oldset;
+    sigemptyset(&set);
+    sigaddset(&set, SNAPSHOT_WAKEUP_SIGNAL);
+    sigaddset(&set, SNAPSHOT_PROBE_SIGNAL);
+    sigaddset(&set, SNAPSHOT_TRACE_END_SIGNAL);
+    sigprocmask(SIG_BLOCK, &set, &oldset);
     dut->prepareClone(); // prepareClone can be omitted if a little memory leak is ok
     pid_t child_pid = fork();
     dut->atClone(); // If prepareClone is omitted, call atClone() only in child process
+    if (child_pid != 0) {
+        sigprocmask(SIG_SETMASK, &oldset, NULL);
+    }
     if (child_pid < 0) {
         logger->error("SNAPSHOT: failed to fork new child process");
         return;
     }
     if (child_pid != 0) { // for the original process
-        snapshots.children_pid.push_front(child_pid);
+        snapshots.children.push_front({ child_pid, contextp->time() });
         logger->info("SNAPSHOT created, pid={}", child_pid);
+        if (config.snapshot.mem_max != 0) {
+            snapshot_limit_memory();
+        }
     } else { // for the fork-child snapshot process
         snapshots.is_child = true;
+        // rolling waveform chunks belong to the original process
+        waveform_ring.current.clear();
+        waveform_ring.previous.clear();
+        waveform_ring.abort_ready = false;
+        waveform_roll_time_next = UINT64_MAX;
+        waveform_trigger_armed = false;
+        waveform_stop_armed = false;
         // child process should exit when parent process exits
         if (prctl(PR_SET_PDEATHSIG, SIGKILL) == -1) {
             perror("prctl(PR_SET_PDEATHSIG)");
@@ -442,21 +905,39 @@ void ventus_rtlsim_t::snapshot_fork() {
         if (getppid() == 1) { // parent process already exited
             std::exit(EXIT_FAILURE);
         }
-        // wait for main process
-        sigset_t set, oldset;
+        // wait for main process, answer predicate probes until woken up for rollback
         siginfo_t info;
-        sigemptyset(&set);
-        sigaddset(&set, SNAPSHOT_WAKEUP_SIGNAL);
-        sigprocmask(SIG_BLOCK, &set, &oldset);   // Block SIG for using sigwait
-        sigwaitinfo(&set, &info);                // Wait for snapshot-rollback
+        while (true) {
+            if (sigwaitinfo(&set, &info) < 0) // Wait for snapshot-rollback
+                continue;
+            if (info.si_signo == SNAPSHOT_PROBE_SIGNAL) {
+                sigval_t reply;
+                reply.sival_int = config.snapshot.predicate
+                    ? config.snapshot.predicate(this, config.snapshot.predicate_arg)
+                    : -1;
+                sigqueue(getppid(), SNAPSHOT_PROBE_SIGNAL, reply);
+            } else if (info.si_signo == SNAPSHOT_TRACE_END_SIGNAL) {
+                snapshots.trace_end_time = (uint64_t)(info.si_value.sival_ptr);
+            } else {
+                break;
+            }
+        }
         sigprocmask(SIG_SETMASK, &oldset, NULL); // Change signal blocking mask back
         assert(info.si_signo == SNAPSHOT_WAKEUP_SIGNAL);
         // main process invoked snapshot rollback
         snapshots.main_exit_time = (uint64_t)(info.si_value.sival_ptr);
+#ifdef ENABLE_GVM
+        g_gvm_async.restartAfterFork();
+        g_gvm_trace.abandonAfterFork();
+        gvm.report_file.clear(); // 回滚后重新仿真会再次遇到同一错误，保留主进程写入的报告
+#endif // ENABLE_GVM
         logger->info(
             "SNAPSHOT is activated, sim_time = {}, origin process exited at time {}", contextp->time(),
             snapshots.main_exit_time
         );
+        if (snapshots.trace_end_time != UINT64_MAX) {
+            logger->info("SNAPSHOT dumps waveform until time {}", snapshots.trace_end_time);
+        }
         // create a new waveform dump file
         //  delete tfp;             // Cannot do this, or it will block the process
         //  (maybe because Vdut.fst was already closed in the parent process?)
@@ -472,40 +953,313 @@ void ventus_rtlsim_t::snapshot_fork() {
     }
 }
 
+size_t ventus_rtlsim_t::snapshot_choose_victim() const {
+    const std::deque<snapshot_child_t>& children = snapshots.children;
+    const size_t n = children.size();
+    assert(n > 0);
+    if (strcmp(config.snapshot.retention, "log") != 0 || n <= 2)
+        return n - 1;
+    // children[i-1]较新，children[i+1]较旧，淘汰children[i]后二者的间隔相对于children[i]的距今时间越小越好
+    const uint64_t now = contextp->time();
+    size_t victim = 1;
+    double cost_min = std::numeric_limits<double>::infinity();
+    for (size_t i = 1; i + 1 < n; i++) {
+        double cost = double(children[i - 1].time - children[i + 1].time) / double(now - children[i].time + 1);
+        if (cost < cost_min) {
+            cost_min = cost;
+            victim = i;
+        }
+    }
+    return victim;
+}
+
+void ventus_rtlsim_t::snapshot_evict(size_t idx) {
+    const snapshot_child_t child = snapshots.children[idx];
+    kill(child.pid, SIGKILL);
+    waitpid(child.pid, NULL, 0);
+    snapshots.children.erase(snapshots.children.begin() + idx);
+    logger->debug("SNAPSHOT at time {} deleted, pid={}", child.time, child.pid);
+}
+
+// 进程独占的脏页大小（字节），读取失败时返回0
+static uint64_t process_private_dirty(pid_t pid) {
+    std::ifstream file(fmt::format("/proc/{}/smaps_rollup", pid));
+    std::string line;
+    unsigned long long kb;
+    while (std::getline(file, line)) {
+        if (sscanf(line.c_str(), "Private_Dirty: %llu kB", &kb) == 1)
+            return kb * 1024;
+    }
+    return 0;
+}
+
+void ventus_rtlsim_t::snapshot_limit_memory() {
+    std::vector<uint64_t> sizes;
+    uint64_t total = 0;
+    for (const snapshot_child_t& child : snapshots.children) {
+        sizes.push_back(process_private_dirty(child.pid));
+        total += sizes.back();
+    }
+    while (total > config.snapshot.mem_max && snapshots.children.size() > 1) {
+        size_t victim = snapshot_choose_victim();
+        logger->info(
+            "SNAPSHOT memory {:.1f} MiB exceeds limit {:.1f} MiB, delete the snapshot at time {}", total / 1048576.0,
+            config.snapshot.mem_max / 1048576.0, snapshots.children[victim].time
+        );
+        total -= sizes[victim];
+        sizes.erase(sizes.begin() + victim);
+        snapshot_evict(victim);
+    }
+}
+
 void ventus_rtlsim_t::snapshot_rollback(uint64_t time) {
     if (!config.snapshot.enable || snapshots.is_child)
         return;
-    if (snapshots.children_pid.empty()) {
+    if (snapshots.children.empty()) {
         logger->error("No snapshot for rolling back. Where is the initial snapshot?");
         return;
     }
     assert(dut && contextp);
 
+    size_t idx = snapshots.children.size() - 1; // the oldest snapshot
+    uint64_t trace_end_time = UINT64_MAX;
+    if (strcmp(config.snapshot.rollback, "bisect") == 0 && config.snapshot.predicate) {
+        idx = snapshot_choose_bisect(trace_end_time);
+    } else if (strcmp(config.snapshot.rollback, "oldest") != 0) {
+        uint64_t bad_time = config.snapshot.bad_time;
+        if (bad_time == 0) {
+            bad_time = std::min(first_error_time.load(), time);
+#ifdef ENABLE_GVM
+            bad_time = std::min(bad_time, gvm.divergence_time);
+#endif // ENABLE_GVM
+        }
+        logger->info("SNAPSHOT rollback: first bad time is {}", bad_time);
+        idx = snapshot_choose_nearest(bad_time);
+    }
+    const snapshot_child_t child = snapshots.children[idx];
     logger->info(
-        "SNAPSHOT rollback to {} time-unit ago, pid={}",
-        time % config.snapshot.time_interval + (snapshots.children_pid.size() - 1) * config.snapshot.time_interval,
-        snapshots.children_pid.front()
+        "SNAPSHOT rollback to time {} ({} time-unit ago), pid={}", child.time, time - child.time, child.pid
     );
+
     assert(sizeof(sigval_t) >= sizeof(contextp->time()));
     sigval_t sigval;
+    if (trace_end_time != UINT64_MAX) {
+        sigval.sival_ptr = (void*)(trace_end_time);
+        sigqueue(child.pid, SNAPSHOT_TRACE_END_SIGNAL, sigval);
+    }
     sigval.sival_ptr = (void*)(contextp->time());
+    sigqueue(child.pid, SNAPSHOT_WAKEUP_SIGNAL, sigval); // Activate the snapshot
+    waitpid(child.pid, NULL, 0);                         // Wait for snapshot finished
+    snapshots.children.erase(snapshots.children.begin() + idx);
+}
+
+size_t ventus_rtlsim_t::snapshot_choose_nearest(uint64_t time) const {
+    for (size_t i = 0; i < snapshots.children.size(); i++) {
+        if (snapshots.children[i].time < time)
+            return i;
+    }
+    return snapshots.children.size() - 1;
+}
 
-    pid_t child = snapshots.children_pid.back();     // Choose the oldest snapshot
-    sigqueue(child, SNAPSHOT_WAKEUP_SIGNAL, sigval); // Activate the snapshot
-    waitpid(child, NULL, 0);                         // Wait for snapshot finished
-    snapshots.children_pid.pop_back();
+// 快照冻结在各自的时刻，直接在其上调用predicate即可，无需重新仿真
+// 按时间从旧到新记快照为old[0..n-1]（即children[n-1..0]），结束时的状态为old[n]
+size_t ventus_rtlsim_t::snapshot_choose_bisect(uint64_t& trace_end_time) {
+    const int64_t n = snapshots.children.size();
+    if (config.snapshot.predicate(this, config.snapshot.predicate_arg)) {
+        logger->warn("SNAPSHOT bisect: predicate still holds at exit, rollback to the nearest snapshot");
+        return snapshot_choose_nearest(contextp->time());
+    }
+    int64_t good = -1, bad = n; // predicate holds at old[good] (-1: unknown) and fails at old[bad]
+    while (bad - good > 1) {
+        int64_t mid = good + (bad - good) / 2;
+        int result = snapshot_probe(n - 1 - mid);
+        if (result < 0)
+            break;
+        (result ? good : bad) = mid;
+    }
+    if (good < 0) {
+        logger->warn("SNAPSHOT bisect: predicate already fails at the oldest snapshot");
+        return n - 1;
+    }
+    trace_end_time = bad < n ? snapshots.children[n - 1 - bad].time : UINT64_MAX;
+    logger->info(
+        "SNAPSHOT bisect: predicate turns false between time {} and {}", snapshots.children[n - 1 - good].time,
+        bad < n ? snapshots.children[n - 1 - bad].time : contextp->time()
+    );
+    return n - 1 - good;
+}
+
+int ventus_rtlsim_t::snapshot_probe(size_t idx) {
+    const snapshot_child_t& child = snapshots.children[idx];
+    // 回复信号被忽略时若处于阻塞状态仍会排队，可由sigtimedwait取得；超时后迟到的回复则被丢弃
+    signal(SNAPSHOT_PROBE_SIGNAL, SIG_IGN);
+    sigset_t set, oldset;
+    sigemptyset(&set);
+    sigaddset(&set, SNAPSHOT_PROBE_SIGNAL);
+    sigprocmask(SIG_BLOCK, &set, &oldset);
+    int result = -1;
+    sigval_t sigval;
+    sigval.sival_int = 0;
+    if (sigqueue(child.pid, SNAPSHOT_PROBE_SIGNAL, sigval) == 0) {
+        const timespec timeout = { 60, 0 };
+        siginfo_t info;
+        while (sigtimedwait(&set, &info, &timeout) == SNAPSHOT_PROBE_SIGNAL) {
+            if (info.si_pid == child.pid) {
+                result = info.si_value.sival_int;
+                break;
+            }
+        }
+    }
+    sigprocmask(SIG_SETMASK, &oldset, NULL);
+    logger->info(
+        "SNAPSHOT at time {} (pid={}): predicate {}", child.time, child.pid,
+        result < 0 ? "no reply" : (result ? "holds" : "fails")
+    );
+    return result;
 }
 
 void ventus_rtlsim_t::snapshot_kill_all() {
-    while (!snapshots.children_pid.empty()) {
-        pid_t child = snapshots.children_pid.back();
+    while (!snapshots.children.empty()) {
+        pid_t child = snapshots.children.back().pid;
         kill(child, SIGKILL);
         waitpid(child, NULL, 0);
-        snapshots.children_pid.pop_back();
+        snapshots.children.pop_back();
     }
     logger->debug("All snapshot process are cleared, OK");
 }
 
+//
+// Checkpoint
+//
+// 文件格式：VerilatedSave的文件头，之后依次是CHECKPOINT_MAGIC与版本号、决定仿真器结构的配置、Cta、PhysicalMemory、
+// 仿真时间、DUT模型、其余杂项状态，最后以CHECKPOINT_END结尾（VerilatedRestore读到文件末尾后只返回全零，借此发现文件不完整）
+//
+
+#if defined(VENTUS_RTLSIM_SAVABLE) && !defined(ENABLE_GVM)
+constexpr char CHECKPOINT_MAGIC[8] = "VTRTLCK";
+constexpr char CHECKPOINT_END[8] = "VTCKEND";
+constexpr uint32_t CHECKPOINT_VERSION = 2; // 2: ventus_kernel_metadata_t新增字段移到末尾
+
+class VerilatedCheckpointOut : public CheckpointOut {
+public:
+    explicit VerilatedCheckpointOut(VerilatedSerialize& os)
+        : m_os(os) {}
+    void write(const void* data, size_t size) override { m_os.write(data, size); }
+
+private:
+    VerilatedSerialize& m_os;
+};
+
+class VerilatedCheckpointIn : public CheckpointIn {
+public:
+    explicit VerilatedCheckpointIn(VerilatedDeserialize& is)
+        : m_is(is) {}
+    void read(void* data, size_t size) override { m_is.read(data, size); }
+
+private:
+    VerilatedDeserialize& m_is;
+};
+#endif // VENTUS_RTLSIM_SAVABLE && !ENABLE_GVM
+
+bool ventus_rtlsim_t::checkpoint_save(const char* path) {
+#if !defined(VENTUS_RTLSIM_SAVABLE)
+    logger->error("Checkpoint: not supported, rebuild libVentusRTL with SAVABLE=1");
+    return false;
+#elif defined(ENABLE_GVM)
+    logger->error("Checkpoint: not supported in GVM build, the REF state cannot be saved");
+    return false;
+#else
+    VerilatedSave os;
+    os.open(path);
+    if (!os.isOpen()) {
+        logger->error("Checkpoint: cannot open {} for writing", path);
+        return false;
+    }
+    VerilatedCheckpointOut out(os);
+    out.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    out.pod(CHECKPOINT_VERSION);
+    out.pod(config.pmem.pagesize);
+    out.pod(config.pmem.auto_alloc);
+    out.str(config.pmem.backend ? config.pmem.backend : "");
+    out.pod(config.cta.concurrent_kernel);
+    if (!cta->checkpoint_save(out)) {
+        os.close();
+        unlink(path);
+        return false;
+    }
+    pmem->checkpoint_save(out);
+    out.pod<uint64_t>(contextp->time());
+    os << *dut;
+    out.pod(need_icache_invalidate);
+    out.pod(watch);
+    out.pod(step_status);
+    out.write(CHECKPOINT_END, sizeof(CHECKPOINT_END));
+    os.close();
+    logger->info("Checkpoint: saved to {}", path);
+    return true;
+#endif
+}
+
+ventus_rtlsim_t* ventus_rtlsim_t::checkpoint_restore(
+    const char* path, const ventus_rtlsim_config_t* config_, std::function<void(const metadata_t*)> finish_callback
+) {
+#if !defined(VENTUS_RTLSIM_SAVABLE) || defined(ENABLE_GVM)
+    std::cerr << "Checkpoint: not supported in this build of libVentusRTL" << std::endl;
+    return nullptr;
+#else
+    VerilatedRestore is;
+    is.open(path);
+    if (!is.isOpen()) {
+        std::cerr << "Checkpoint: cannot open " << path << std::endl;
+        return nullptr;
+    }
+    VerilatedCheckpointIn in(is);
+    char magic[sizeof(CHECKPOINT_MAGIC)];
+    in.read(magic, sizeof(magic));
+    if (memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0 || in.pod<uint32_t>() != CHECKPOINT_VERSION) {
+        std::cerr << "Checkpoint: " << path << " is not a checkpoint of this libVentusRTL version" << std::endl;
+        return nullptr;
+    }
+    // 仿真器结构以检查点中的配置为准，其余配置（日志、波形、快照等）使用调用者给出的
+    ventus_rtlsim_config_t config = *config_;
+    in.pod(config.pmem.pagesize);
+    in.pod(config.pmem.auto_alloc);
+    config.pmem.backend = in.str() == "mmap" ? "mmap" : "pagetable";
+    in.pod(config.cta.concurrent_kernel);
+
+    ventus_rtlsim_t* sim = new ventus_rtlsim_t();
+    sim->constructor(&config);
+    sim->snapshot_kill_all(); // 构造时fork的快照是复位前的状态，与恢复后的仿真无关
+    sim->cta->checkpoint_restore(in, finish_callback);
+    bool ok = sim->pmem->checkpoint_restore(in);
+    uint64_t time = in.pod<uint64_t>();
+    is >> *sim->dut;
+    sim->contextp->time(time);
+    in.pod(sim->need_icache_invalidate);
+    in.pod(sim->watch);
+    in.pod(sim->step_status);
+    char end[sizeof(CHECKPOINT_END)];
+    in.read(end, sizeof(end));
+    is.close();
+    if (!ok || memcmp(end, CHECKPOINT_END, sizeof(end)) != 0) {
+        sim->logger->critical("Checkpoint: {} is truncated or corrupted", path);
+        sim->destructor(false);
+        delete sim;
+        return nullptr;
+    }
+
+    sim->log_time_next = time_next_aligned(time, LOG_TIME_INTERVAL);
+    sim->snapshot_time_next
+        = time_next_aligned(time, sim->config.snapshot.enable ? sim->config.snapshot.time_interval : 0);
+    sim->waveform_roll_time_next = time_next_aligned(time, sim->config.waveform.rolling);
+    sim->housekeeping_time_next
+        = std::min({ sim->log_time_next, sim->snapshot_time_next, sim->waveform_roll_time_next });
+    sim->snapshot_fork();
+    sim->logger->info("Checkpoint: restored from {}", path);
+    return sim;
+#endif
+}
+
 void ventus_rtlsim_t::waveform_dump() const {
     // snapshot child process always enables waveform dump
     bool is_snapshot = config.snapshot.enable && snapshots.is_child;
@@ -514,11 +1268,120 @@ void ventus_rtlsim_t::waveform_dump() const {
 
     assert(contextp && tfp);
     uint64_t time = contextp->time();
-    if (is_snapshot || time >= config.waveform.time_begin && time < config.waveform.time_end) {
+    if (is_snapshot) {
+        if (time < snapshots.trace_end_time)
+            tfp->dump(time);
+        return;
+    }
+    // 触发前仅在需要保留触发前波形（滚动波形）时输出
+    if (time >= config.waveform.time_begin && time < config.waveform.time_end
+        && !(waveform_trigger_armed && !config.waveform.rolling)) {
         tfp->dump(time);
     }
 }
 
+void ventus_rtlsim_t::waveform_roll() {
+    assert(tfp);
+    if (tfp->isOpen())
+        tfp->close();
+    if (!waveform_ring.previous.empty())
+        std::remove(waveform_ring.previous.c_str());
+    waveform_ring.previous = waveform_ring.current;
+    waveform_ring.current
+        = fmt::format("{}/ventus_rtlsim.{}.{}.fst", config.waveform.rolling_dir, getpid(), waveform_ring.seq++);
+    tfp->open(waveform_ring.current.c_str()); // 每段开头都是完整的信号值，可单独打开
+    waveform_ring_prepare_abort();
+}
+
+// logs/a.fst -> logs/a{suffix}.fst
+static std::string filename_with_suffix(const std::string& filename, const char* suffix) {
+    return filename.ends_with(".fst") ? filename.substr(0, filename.size() - 4) + suffix + ".fst" : filename + suffix;
+}
+
+void ventus_rtlsim_t::waveform_ring_prepare_abort() {
+    waveform_ring.abort_ready = false;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    const std::string filename = config.waveform.filename;
+    const std::string src[3] = { waveform_ring.current, waveform_ring.current + ".hier", waveform_ring.previous };
+    const std::string dst[3] = { filename, filename + ".hier", filename_with_suffix(filename, ".prev") };
+    for (int i = 0; i < 3; i++) {
+        if (src[i].size() >= PATH_MAX || dst[i].size() >= PATH_MAX)
+            return;
+        strcpy(waveform_ring.abort_src[i], src[i].c_str());
+        strcpy(waveform_ring.abort_dst[i], dst[i].c_str());
+    }
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    waveform_ring.abort_ready = true;
+}
+
+void ventus_rtlsim_t::waveform_trigger_fire(const std::string& reason) {
+    uint64_t time = contextp->time();
+    waveform_trigger_armed = false;
+    waveform_trigger_time = time;
+    logger->info("Waveform triggered by {}", reason);
+    // 保留触发前的滚动波形段，不再换段；post_cycles后写出并停止输出
+    uint64_t post = config.waveform.trigger.post_cycles;
+    if (!config.waveform.rolling) {
+        tfp->open(config.waveform.filename);
+    } else if (post == 0) {
+        // 输出到仿真结束：先写出触发前的段，之后直接写入文件，避免/dev/shm中的段一直增长
+        tfp->close();
+        waveform_ring_finish(true);
+        config.waveform.rolling = 0;
+        std::string post_filename = filename_with_suffix(config.waveform.filename, ".post");
+        tfp->open(post_filename.c_str());
+        logger->info("Waveform after the trigger is dumped to {}", post_filename);
+    }
+    waveform_roll_time_next = post ? time + post * 2 * HALF_CYCLE_TIME : UINT64_MAX;
+    housekeeping_time_next = std::min(housekeeping_time_next, waveform_roll_time_next);
+    waveform_stop_armed = waveform_match_enabled(config.waveform.trigger.stop);
+}
+
+void ventus_rtlsim_t::waveform_trigger_stop(const std::string& reason) {
+    uint64_t time = contextp->time();
+    waveform_stop_armed = false;
+    waveform_stop_time = time;
+    logger->info("Waveform stopped by {}", reason);
+    // 与post_cycles到期相同，由housekeeping()写出波形并停止输出
+    waveform_roll_time_next = time;
+    housekeeping_time_next = time;
+}
+
+// 跨文件系统时rename失败，改为复制
+static bool move_file(const std::string& from, const std::string& to) {
+    std::error_code ec;
+    std::filesystem::rename(from, to, ec);
+    if (ec) {
+        std::filesystem::copy_file(from, to, std::filesystem::copy_options::overwrite_existing, ec);
+        std::filesystem::remove(from);
+    }
+    return !ec;
+}
+
+void ventus_rtlsim_t::waveform_ring_finish(bool keep) {
+    if (waveform_ring.current.empty())
+        return;
+    waveform_ring.abort_ready = false;
+    if (!keep) {
+        std::remove(waveform_ring.current.c_str());
+        if (!waveform_ring.previous.empty())
+            std::remove(waveform_ring.previous.c_str());
+    } else {
+        std::string filename = config.waveform.filename;
+        std::string prev_filename = filename_with_suffix(filename, ".prev");
+        if (!waveform_ring.previous.empty() && move_file(waveform_ring.previous, prev_filename)) {
+            logger->info("Rolling waveform: earlier chunk saved as {}", prev_filename);
+        }
+        if (move_file(waveform_ring.current, filename)) {
+            logger->info("Rolling waveform: last chunk saved as {}", filename);
+        } else {
+            logger->error("Rolling waveform: failed to save {} as {}", waveform_ring.current, filename);
+        }
+    }
+    waveform_ring.current.clear();
+    waveform_ring.previous.clear();
+}
+
 void ventus_rtlsim_t::dut_reset() const {
     assert(dut && contextp);
     contextp->time(0);
@@ -3,8 +3,13 @@
 #include "Vdut.h"
 #include "cta_sche_wrapper.hpp"
 #include "physical_mem.hpp"
+#include "timeline.hpp"
 #include "ventus_rtlsim.h"
+#include <atomic>
+#include <climits>
+#include <csignal>
 #include <memory>
+#include <string>
 #include <verilated.h>
 #include <verilated_fst_c.h>
 
@@ -13,11 +18,19 @@ extern const std::unordered_map<std::string, int> rtl_parameters;
 #include "gvm.hpp"
 #endif // ENABLE_GVM
 
-#define SNAPSHOT_WAKEUP_SIGNAL SIGRTMIN
+// Pending realtime signals are delivered lowest-numbered first, so TRACE_END must be numbered below WAKEUP
+#define SNAPSHOT_TRACE_END_SIGNAL SIGRTMIN    // value: trace_end_time, sent before SNAPSHOT_WAKEUP_SIGNAL
+#define SNAPSHOT_PROBE_SIGNAL (SIGRTMIN + 1)  // evaluate config.snapshot.predicate, reply with the same signal
+#define SNAPSHOT_WAKEUP_SIGNAL (SIGRTMIN + 2) // value: main_exit_time, the snapshot starts to re-simulate
+typedef struct {
+    pid_t pid;
+    uint64_t time; // sim time when the snapshot was forked
+} snapshot_child_t;
 typedef struct {
     bool is_child;
-    uint64_t main_exit_time;        // when does the main simulation process exit
-    std::deque<pid_t> children_pid; // front is newest, back is oldest
+    uint64_t main_exit_time;               // when does the main simulation process exit
+    uint64_t trace_end_time;               // snapshot process dumps waveform before this time only
+    std::deque<snapshot_child_t> children; // front is newest, back is oldest
 } snapshot_t;
 
 extern "C" struct ventus_rtlsim_t {
@@ -30,20 +43,72 @@ extern "C" struct ventus_rtlsim_t {
     ventus_rtlsim_config_t config;
     ventus_rtlsim_step_result_t step_status;
     std::unique_ptr<PhysicalMemory> pmem;
+    std::unique_ptr<Timeline> timeline; // nullptr if disabled
 #ifdef ENABLE_GVM
     gvm_t gvm;
 #endif // ENABLE_GVM
     bool need_icache_invalidate = false;
+    struct {
+        paddr_t base = 0;
+        uint64_t size = 0; // 0 for disabled
+        bool hit = false;  // GPU wrote to the watched range since last run()
+    } watch;
+    struct { // rolling waveform chunks in config.waveform.rolling_dir
+        std::string current;  // chunk being dumped
+        std::string previous; // empty if none
+        uint64_t seq = 0;
+        // abort()时atexit不会执行，由SIGABRT处理函数直接移动各段；路径在换段时预先算好，处理函数中不能分配内存
+        // [0]: current, [1]: current.hier (FST未关闭时留下的层次信息), [2]: previous
+        char abort_src[3][PATH_MAX];
+        char abort_dst[3][PATH_MAX];
+        volatile std::sig_atomic_t abort_ready = false;
+    } waveform_ring;
+    uint64_t log_time_next;          // next time to print clock log
+    uint64_t snapshot_time_next;     // next time to fork a snapshot
+    uint64_t waveform_roll_time_next; // next time to switch to a new rolling waveform chunk
+    bool waveform_trigger_armed = false;          // config.waveform.trigger has conditions and has not fired yet
+    uint64_t waveform_trigger_time = UINT64_MAX; // when the waveform trigger fired
+    bool waveform_stop_armed = false;            // config.waveform.trigger.stop has conditions and may fire now
+    uint64_t waveform_stop_time = UINT64_MAX;    // when the stop condition of the waveform trigger fired
+    uint64_t housekeeping_time_next; // min of the above, checked every half cycle
+    std::atomic<uint64_t> first_error_time = UINT64_MAX; // time of the first error log, for snapshot rollback
 
     void constructor(const ventus_rtlsim_config_t* config);
     void dut_reset() const;
     const ventus_rtlsim_step_result_t* step();
+    void run(uint64_t max_cycles, uint32_t stop_mask, ventus_rtlsim_run_result_t* result);
     void destructor(bool snapshot_rollback_forcing);
 
+    bool half_cycle();
+    void update_step_status(bool sim_got_error);
+    void housekeeping();
+    void handle_signals();
+    uint64_t log_time() const; // sim time to stamp logs with, may be called from the GVM checking thread
+
     void waveform_dump() const;
+    void waveform_roll();                    // close the current chunk, drop the previous one and open a new one
+    void waveform_ring_finish(bool keep);    // move the chunks to config.waveform.filename, or remove them
+    void waveform_ring_prepare_abort();      // fill waveform_ring.abort_* for the SIGABRT handler
+    void waveform_trigger_fire(const std::string& reason);
+    void waveform_trigger_stop(const std::string& reason); // end the waveform window as post_cycles does
     void snapshot_fork();
+    size_t snapshot_choose_victim() const; // index in snapshots.children, never the newest if more than one
+    void snapshot_evict(size_t idx);
+    void snapshot_limit_memory(); // evict snapshots until their private dirty memory is within config.snapshot.mem_max
     void snapshot_rollback(uint64_t time);
+    size_t snapshot_choose_nearest(uint64_t time) const; // index in snapshots.children
+    size_t snapshot_choose_bisect(uint64_t& trace_end_time); // also gives the end of the interval to dump
+    int snapshot_probe(size_t idx); // evaluate the predicate in a snapshot, 1: good, 0: bad, -1: no reply
     void snapshot_kill_all();
+
+    // 检查点：将整个仿真状态保存到文件，之后可在其他进程中恢复（需以SAVABLE=1构建，GVM构建中不支持）
+    bool checkpoint_save(const char* path);
+    static ventus_rtlsim_t* checkpoint_restore(
+        const char* path, const ventus_rtlsim_config_t* config, std::function<void(const metadata_t*)> finish_callback
+    );
+#ifdef ENABLE_GVM
+    void gvm_mem_check(); // 所有kernel结束时比对DUT写入过的页与REF内存
+#endif // ENABLE_GVM
 };
 
 inline static paddr_t pmem_get_page_base(paddr_t paddr, uint64_t pagesize) { return paddr - paddr % pagesize; }
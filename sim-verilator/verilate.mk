@@ -5,6 +5,7 @@ endif
 export MAKEFLAGS += +r
 
 RELEASE ?= 0
+SAVABLE ?= 0
 PREFIX ?= $(CURDIR)/install
 
 export RTL_GVM_ENABLED = false
@@ -61,7 +62,7 @@ endif
 VLIB_SRC_SCALA = $(shell find $(VLIB_DIR_SCALA) -name "*.scala")
 VLIB_SRC_V = dut.v
 VLIB_SRC_CXX_EXPORT = ventus_rtlsim.cpp # API in these files will be exported to shared library
-VLIB_SRC_CXX = kernel.cpp physical_mem.cpp cta_sche_wrapper.cpp ventus_rtlsim_impl.cpp rtl_parameters.cpp $(VLIB_SRC_CXX_EXPORT)
+VLIB_SRC_CXX = kernel.cpp physical_mem.cpp cta_sche_wrapper.cpp timeline.cpp ventus_rtlsim_impl.cpp rtl_parameters.cpp $(VLIB_SRC_CXX_EXPORT)
 VLIB_SRC_CXX_ABSPATH = $(abspath $(VLIB_SRC_CXX))
 VLIB_VERILATOR_INPUT = $(VLIB_SRC_V) $(VLIB_SRC_CXX_ABSPATH)
 VLIB_VERILATOR_OUTPUT = $(VLIB_DIR_BUILDOBJ)/libVdut.a
@@ -108,6 +109,10 @@ VLIB_VERILATOR_FLAGS += -DRANDOMIZE_REG_INIT
 VLIB_VERILATOR_FLAGS += --trace-fst
 # Check SystemVerilog assertions
 VLIB_VERILATOR_FLAGS += --assert
+# Enable ventus_rtlsim_checkpoint_save/restore
+ifeq ($(SAVABLE),1)
+VLIB_VERILATOR_FLAGS += --savable
+endif
 # Generate coverage analysis
 #VLIB_VERILATOR_FLAGS += --coverage
 # Run Verilator in debug mode
@@ -124,6 +129,9 @@ VLIB_CFLAGS += -fPIC
 VLIB_CXXFLAGS += $(VLIB_CFLAGS)
 VLIB_CXXFLAGS += -std=c++20
 VLIB_CXXFLAGS += -DSPDLOG_ACTIVE_LEVEL=SPDLOG_LEVEL_TRACE
+ifeq ($(SAVABLE),1)
+VLIB_CXXFLAGS += -DVENTUS_RTLSIM_SAVABLE=1
+endif
 VLIB_LDFLAGS += -lc
 ifeq ($(MOLD),1)
 VLIB_LDFLAGS += -fuse-ld=mold
@@ -167,7 +175,29 @@ $(VLIB_TARGET): $(VLIB_VERILATOR_OUTPUT)
 
 lib: $(VLIB_TARGET)
 
-.PHONY: verilog verilate lib
+# Standalone benchmarks, no verilated model needed. Build with RELEASE=1 for meaningful numbers
+BENCH_PMEM_SRC_CXX = bench/pmem_bench.cpp physical_mem.cpp
+BENCH_PMEM_TARGET = $(VLIB_DIR_BUILDOBJ)/pmem-bench
+
+$(BENCH_PMEM_TARGET): $(BENCH_PMEM_SRC_CXX) $(wildcard *.hpp *.h)
+	@mkdir -p $(VLIB_DIR_BUILDOBJ)
+	$(CXX) $(VLIB_CXXFLAGS) -I. -o $@ $(BENCH_PMEM_SRC_CXX) -lspdlog -lfmt
+	ln -sf $(abspath $(BENCH_PMEM_TARGET)) $(VLIB_DIR_BUILD)/pmem-bench
+
+pmem-bench: $(BENCH_PMEM_TARGET)
+
+# bench/Vdut.h stands in for the verilated model
+BENCH_CTA_SRC_CXX = bench/cta_bench.cpp cta_sche_wrapper.cpp kernel.cpp timeline.cpp
+BENCH_CTA_TARGET = $(VLIB_DIR_BUILDOBJ)/cta-bench
+
+$(BENCH_CTA_TARGET): $(BENCH_CTA_SRC_CXX) bench/Vdut.h $(wildcard *.hpp *.h)
+	@mkdir -p $(VLIB_DIR_BUILDOBJ)
+	$(CXX) $(VLIB_CXXFLAGS) -Ibench -I. -o $@ $(BENCH_CTA_SRC_CXX) -lspdlog -lfmt
+	ln -sf $(abspath $(BENCH_CTA_TARGET)) $(VLIB_DIR_BUILD)/cta-bench
+
+cta-bench: $(BENCH_CTA_TARGET)
+
+.PHONY: verilog verilate lib pmem-bench cta-bench
 
 #=====================================================================
 # Other targets
@@ -185,7 +215,9 @@ install: $(VLIB_TARGET)
 clean-lib:
 	-rm -f $(VLIB_DIR_BUILDOBJ_DEBUG)/*.a $(VLIB_DIR_BUILDOBJ_DEBUG)/*.o $(VLIB_DIR_BUILDOBJ_DEBUG)/*.so
 	-rm -f $(VLIB_DIR_BUILDOBJ_RELEASE)/*.a $(VLIB_DIR_BUILDOBJ_RELEASE)/*.o $(VLIB_DIR_BUILDOBJ_RELEASE)/*.so
-	-rm -f $(VLIB_DIR_BUILD)/*.so
+	-rm -f $(VLIB_DIR_BUILDOBJ_DEBUG)/pmem-bench $(VLIB_DIR_BUILDOBJ_RELEASE)/pmem-bench
+	-rm -f $(VLIB_DIR_BUILDOBJ_DEBUG)/cta-bench $(VLIB_DIR_BUILDOBJ_RELEASE)/cta-bench
+	-rm -f $(VLIB_DIR_BUILD)/*.so $(VLIB_DIR_BUILD)/pmem-bench $(VLIB_DIR_BUILD)/cta-bench
 
 clean-lib-dep: clean-lib
 	-rm -f $(VLIB_DIR_BUILDOBJ_DEBUG)/*.d
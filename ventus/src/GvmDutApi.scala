@@ -198,27 +198,31 @@ class GvmDutXReg extends ExtModule with HasExtModuleInline {
     |  input  wire [${(NUMBER_SGPR_SLOTS * 32) - 1}:0] io_xbanks
     |);
     |
-    |  import "DPI-C" function void c_GvmDutXReg(
+    |  import "DPI-C" context function void c_GvmDutXRegRegister(
     |    input int num_sm,
     |    input int sm_id,
     |    input int num_bank,
-    |    input int num_sgpr_slots,
-    |    input int xbanks_word,
-    |    input int xbanks_word_idx
+    |    input int num_sgpr_slots
     |  );
+    |  export "DPI-C" function GvmDutXRegRead;
     |
-    |  integer i;
+    |  // 寄存器堆不再每周期传给 DPI，而是由 GVM 在需要时（新 warp 分派、retire 比对）
+    |  // 经 svSetScope 选中对应 SM 后调用本函数，一次性读出整个 xbank
+    |  function void GvmDutXRegRead(output bit [${(NUMBER_SGPR_SLOTS * 32) - 1}:0] xbanks);
+    |    xbanks = io_xbanks;
+    |  endfunction
+    |
+    |  // 首个时钟沿向 C++ 登记本实例的 scope
+    |  reg registered = 1'b0;
     |  always @(posedge io_clock) begin
-    |    // 每个时钟周期都把最新的 xbank 状态传给 DPI
-    |    for (i = 0; i < ${NUMBER_SGPR_SLOTS}; i = i + 1) begin
-    |    c_GvmDutXReg(
-    |      ${num_sm},
-    |      io_sm_id,
-    |      ${num_bank},
-    |      ${NUMBER_SGPR_SLOTS},
-    |      io_xbanks[32*i +:32],
-    |      i
-    |    );
+    |    if (!registered) begin
+    |      c_GvmDutXRegRegister(
+    |        ${num_sm},
+    |        io_sm_id,
+    |        ${num_bank},
+    |        ${NUMBER_SGPR_SLOTS}
+    |      );
+    |      registered <= 1'b1;
     |    end
     |  end
     |endmodule
@@ -259,34 +263,32 @@ class GvmDutVRegWriteback extends ExtModule with HasExtModuleInline {
     |
     |  import "DPI-C" function void c_GvmDutVRegWriteback(
     |    input int   sm_id,
-    |    input int   rd_data,
+    |    input bit [${num_thread * xLen - 1}:0] rd_data,
     |    input bit   is_vector_wb,
     |    input int   reg_idx,
     |    input int   hardware_warp_id,
     |    input int   pc,
     |    input int   inst,
     |    input int   dispatch_id,
-    |    input bit   wvd_mask,
-    |    input int   thread_idx
+    |    input bit [${num_thread - 1}:0] wvd_mask,
+    |    input int   num_thread
     |  );
     |
-    |  integer i;
+    |  // 整个向量一次性传入，每次写回仅调用一次 DPI
     |  always @(posedge io_clock) begin
     |    if (io_fire) begin
-    |      for (i = 0; i < ${num_thread}; i = i + 1) begin
-    |        c_GvmDutVRegWriteback(
-    |          io_sm_id,
-    |          io_rd[${xLen}*i +:${xLen}],
-    |          io_is_vector_wb,
-    |          io_reg_idx,
-    |          io_hardware_warp_id,
-    |          io_pc,
-    |          io_inst,
-    |          io_dispatch_id,
-    |          io_wvd_mask[i],
-    |          i
-    |        );
-    |      end
+    |      c_GvmDutVRegWriteback(
+    |        io_sm_id,
+    |        io_rd,
+    |        io_is_vector_wb,
+    |        io_reg_idx,
+    |        io_hardware_warp_id,
+    |        io_pc,
+    |        io_inst,
+    |        io_dispatch_id,
+    |        io_wvd_mask,
+    |        ${num_thread}
+    |      );
     |    end
     |  end
     |endmodule